@@ -0,0 +1,60 @@
+#ifndef ANIMATIONTABLE_HPP
+#define ANIMATIONTABLE_HPP
+
+#include <vector>
+#include "ObjectStore.hpp"
+#include "SceneObjects/Function.hpp"
+#include "headers.hpp"
+
+namespace ParamWorld
+{
+/**
+ * The growth animations of every object that is still growing, kept as flat arrays (one per
+ * field) so they are all evaluated in one pass a frame. Animations are dropped from the
+ * table once they finish.
+ */
+class AnimationTable
+{
+   public:
+    // Starts animating the object at handle, which grows from rootPosition.
+    void add(ObjectHandle handle, const Function &growth, glm::vec3 rootPosition);
+
+    /**
+     * Evaluates every animation at time, and writes the model matrices of the objects. Those
+     * that are done growing are removed, and their handles added to finished.
+     */
+    void update(double time, std::vector<ObjectHandle> &finished);
+
+    // Removes the animations of the objects that remove(handle) is true for.
+    template <typename Predicate>
+    void removeIf(Predicate remove)
+    {
+        for (size_t i = _handles.size(); i-- > 0;) {
+            if (remove(_handles[i])) {
+                erase(i);
+            }
+        }
+    }
+
+    size_t size() const { return _handles.size(); }
+    bool empty() const { return _handles.empty(); }
+    ObjectHandle handle(size_t i) const { return _handles[i]; }
+    // The model matrix of the i-th object, as of the last update().
+    const glm::mat4 &modelMatrix(size_t i) const { return _modelMatrices[i]; }
+
+   private:
+    // Swaps the last animation into i.
+    void erase(size_t i);
+
+    std::vector<ObjectHandle> _handles;
+    std::vector<Function::Kind> _kinds;
+    std::vector<double> _offsets, _rates;
+    std::vector<float> _rootX, _rootY, _rootZ;
+    std::vector<glm::mat4> _modelMatrices;
+    // Scratch space for update().
+    std::vector<float> _scales;
+    std::vector<char> _saturated;
+};
+}
+
+#endif
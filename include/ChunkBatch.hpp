@@ -0,0 +1,71 @@
+#ifndef CHUNKBATCH_HPP
+#define CHUNKBATCH_HPP
+
+#include "ImpostorAtlas.hpp"
+#include "SceneObjects/Model.hpp"
+#include "SceneObjects/SceneObject.hpp"
+#include "headers.hpp"
+
+namespace ParamWorld
+{
+/**
+ * All of the finished (no longer growing) geometry in one grid square of the world, baked
+ * into a single model per level of detail so the whole square is drawn with one call.
+ */
+class ChunkBatch
+{
+   public:
+    // Levels of detail kept for each chunk; objects with fewer levels repeat their coarsest.
+    static const int LodCount = 4;
+    // Level past the coarsest one, where objects with an impostor are drawn as one and the
+    // rest at their coarsest level.
+    static const int ImpostorLod = LodCount;
+
+    /**
+     * Bakes the object's geometry, at its root position and every level of detail, into
+     * this chunk.
+     * Should only be called once the object is done growing.
+     */
+    void Add(const SceneObject &object);
+    // Same as Add(object), but draws the object with its impostor at ImpostorLod. The
+    // impostor is in the object's model space.
+    void Add(const SceneObject &object, const ImpostorInstance &impostor);
+
+    /**
+     * Uploads up to maxBytes of the geometry added since the last upload, over every level
+     * of detail. Returns how many bytes were sent.
+     */
+    size_t uploadSome(size_t maxBytes);
+    bool uploaded() const;
+
+    /**
+     * Draws the chunk at a level of detail (up to ImpostorLod), as far as it has been
+     * uploaded.
+     * The model matrix of a chunk is a translation to its origin(), so the MVP should
+     * already be set to Perspective * View * translate(origin()).
+     */
+    void Draw(int lod = 0);
+
+    // Draws the instanced boxes in the chunk, which are stored in world space, so the MVP
+    // should be Perspective * View. Needs the instanced shader, and should come after Draw()
+    // at the same level of detail in a frame.
+    void DrawInstances(int lod = 0);
+
+    // Draws the impostors in the chunk, in world space. Needs the impostor shader, set up
+    // with ImpostorAtlas::bind().
+    void DrawImpostors() { _impostors.draw(); }
+    const std::vector<ImpostorInstance> &impostors() const { return _impostors.instances(); }
+
+    // Where the chunk's triangles are measured from.
+    glm::vec3 origin() const { return _models[0].origin(); }
+    // World space box around everything baked into the chunk.
+    const Bounds &bounds() const { return _models[0].bounds(); }
+
+   private:
+    Model _models[ImpostorLod + 1];
+    ImpostorBatch _impostors;
+    bool _empty = true;
+};
+}
+
+#endif
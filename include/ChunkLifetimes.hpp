@@ -0,0 +1,95 @@
+#ifndef CHUNKLIFETIMES_HPP
+#define CHUNKLIFETIMES_HPP
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "GenerationQueue.hpp"
+#include "ObjectStore.hpp"
+#include "Square.hpp"
+#include "headers.hpp"
+
+namespace ParamWorld
+{
+/**
+ * Decides which squares of the world are kept in memory. Remembers the jobs that generated
+ * each square, so a square far from the player can be evicted (its objects and chunk freed)
+ * and built again from the same jobs when the player comes back.
+ */
+class ChunkLifetimes
+{
+   public:
+    /**
+     * Squares further than evictionRadius from the player are evicted. Evicted squares come
+     * back once the player is within returnFraction of that again, so walking along the
+     * edge doesn't build and free the same squares over and over.
+     */
+    explicit ChunkLifetimes(float evictionRadius = 300.0f, float returnFraction = 0.8f)
+        : _evictionRadius(evictionRadius), _returnFraction(returnFraction)
+    {
+    }
+
+    void setEvictionRadius(float radius) { _evictionRadius = radius; }
+
+    // Returns true the first time it's called for a square, when things should be added
+    // to it.
+    bool explore(Square square);
+    // Remembers a job, in the square that its object will be in, and stamps it with that
+    // square's generation.
+    void addJob(GenerationJob &job);
+    // Records an object built from a job. Returns false if its square was evicted since the
+    // job was queued, in which case the object should just be dropped.
+    bool addObject(const GenerationJob &job, ObjectHandle handle);
+    // Marks the job that built a resident object as learned from (see GenerationJob::learned).
+    void learn(glm::vec3 rootPosition, ObjectHandle handle);
+    // Whether the job that built a resident object has been learned from.
+    bool learned(glm::vec3 rootPosition, ObjectHandle handle) const;
+
+    /**
+     * Evicts squares that are too far from position, and brings back evicted squares that
+     * are close again.
+     * @param evictedSquares gets each square that was evicted.
+     * @param evictedObjects gets the objects that were in them, to be freed.
+     * @param jobs gets the jobs that built the squares that came back, to be run again. They
+     * build their objects fully grown.
+     */
+    void update(glm::vec3 position, std::vector<Square> &evictedSquares,
+                std::vector<ObjectHandle> &evictedObjects, std::vector<GenerationJob> &jobs);
+
+    size_t residentSquares() const { return _resident.size(); }
+    size_t evictedSquares() const { return _squares.size() - _resident.size(); }
+
+   private:
+    // An object in a square, and the index of the job that built it.
+    struct Built {
+        ObjectHandle handle;
+        uint32_t job;
+    };
+    struct Contents {
+        std::vector<GenerationJob> jobs;
+        std::vector<Built> objects;
+        // Counts evictions, so results of jobs queued before the last one can be told apart.
+        uint32_t generation = 0;
+        bool resident = true;
+        // Whether the player has been in the square; other squares can still get jobs that
+        // land in them from next door.
+        bool explored = false;
+    };
+
+    // Distance along the ground from position to the middle of a square.
+    static float distance(Square square, glm::vec3 position);
+    // The square's contents, made resident if it's new.
+    Contents &contents(Square square);
+    // The job that built a resident object, or nullptr if there isn't one.
+    const GenerationJob *jobFor(glm::vec3 rootPosition, ObjectHandle handle) const;
+
+    std::unordered_map<Square, Contents> _squares;
+    // The squares that are resident, so that update() only looks at those and the ones
+    // around the player, and not at every square ever seen.
+    std::unordered_set<Square> _resident;
+    float _evictionRadius, _returnFraction;
+};
+}
+
+#endif
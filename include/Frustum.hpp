@@ -0,0 +1,32 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include "SceneObjects/Bounds.hpp"
+#include "headers.hpp"
+
+namespace ParamWorld
+{
+/**
+ * The volume that a camera can see, as six planes whose normals point inward.
+ */
+class Frustum
+{
+   public:
+    /**
+     * @param viewProjection Perspective * View for the camera. Using Perspective * View * Model
+     * gives the frustum in that model's space instead of world space.
+     */
+    explicit Frustum(const glm::mat4 &viewProjection);
+
+    // False only if the box is definitely outside of the frustum.
+    bool intersects(const Bounds &box) const;
+    // False only if the sphere is definitely outside of the frustum.
+    bool intersects(glm::vec3 center, float radius) const;
+
+   private:
+    // (a, b, c, d) of the plane ax + by + cz + d = 0, with (a, b, c) normalized.
+    glm::vec4 _planes[6];
+};
+}
+
+#endif
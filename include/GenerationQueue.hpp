@@ -0,0 +1,89 @@
+#ifndef GENERATIONQUEUE_HPP
+#define GENERATIONQUEUE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Params/AvailableParameters.h"
+#include "Params/ParamArray.hpp"
+#include "SceneObjects/MeshCache.hpp"
+#include "SceneObjects/SceneObject.hpp"
+#include "headers.hpp"
+
+namespace ParamWorld
+{
+/**
+ * Everything needed to build one new object, decided on the main thread.
+ */
+struct GenerationJob {
+    enum Kind { Tree, Rock };
+
+    Kind kind;
+    glm::vec3 rootPosition;
+    ParamArray<SP_Count> params;
+    // For the object's own random choices (a rock's shape), so it can be built again the same.
+    uint64_t seed = 0;
+    // Which time round its square was built (see ChunkLifetimes), to spot results from
+    // before the square was last evicted.
+    uint32_t generation = 0;
+    // Its place among its square's jobs, also stamped by ChunkLifetimes.
+    uint32_t index = 0;
+    // Set once the player has learned from its object, so that building it again when its
+    // square comes back doesn't teach the params the same thing twice.
+    bool learned = false;
+    // Builds the object as it is once it has finished growing, for squares that come back.
+    bool fullyGrown = false;
+};
+
+// An object finished by a GenerationQueue, with the job it was built from.
+struct GeneratedObject {
+    GenerationJob job;
+    std::unique_ptr<SceneObject> object;
+};
+
+/**
+ * Builds new objects' geometry on worker threads, so that entering a new square doesn't
+ * stall a frame. Only CPU side work happens on the workers: the finished objects still need
+ * init() (the GL upload) on the thread with the GL context.
+ */
+class GenerationQueue
+{
+   public:
+    // Zero workers picks one less than the number of cores, and at least one.
+    explicit GenerationQueue(unsigned workerCount = 0);
+    // Finishes the job each worker is on, drops the rest and joins the workers.
+    ~GenerationQueue();
+
+    void push(GenerationJob job);
+
+    // Moves every object finished so far onto the end of done. Never waits on the workers.
+    void collect(std::vector<GeneratedObject> &done);
+
+    // Number of jobs that are queued or being worked on.
+    size_t pending() const;
+
+    // Meshes shared by the trees this queue builds. freeRetired() is up to the GL thread.
+    MeshCache &meshCache() { return _meshes; }
+
+    // Builds the object for a job on the calling thread, sharing meshes through cache if given.
+    static std::unique_ptr<SceneObject> generate(const GenerationJob &job,
+                                                 MeshCache *cache = nullptr);
+
+   private:
+    void work();
+
+    MeshCache _meshes;
+    std::vector<std::thread> _workers;
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;
+    std::deque<GenerationJob> _jobs;
+    std::vector<GeneratedObject> _finished;
+    size_t _inProgress = 0;
+    bool _stopping = false;
+};
+}
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef IMPOSTORATLAS_HPP
+#define IMPOSTORATLAS_HPP
+
+#include <vector>
+#include "SceneObjects/Model.hpp"
+#include "headers.hpp"
+
+namespace ParamWorld
+{
+/**
+ * An object drawn as a camera facing quad textured with pictures of it: where it is, how big
+ * it is, and which impostor in the atlas it uses (or -1 if it doesn't have one).
+ */
+struct ImpostorInstance {
+    glm::vec3 center;
+    float radius;
+    GLint index;
+};
+
+/**
+ * One texture holding pictures of many objects (trees), each taken from Views angles around
+ * the y axis, so that far away objects can be drawn as a single quad instead of hundreds of
+ * boxes. Pictures are taken with an orthographic camera that just fits the object's bounds.
+ *
+ * Impostors are only drawn far away, so the atlas is mipmapped. Each picture is drawn inside
+ * an empty border of Padding pixels, and only the mip levels whose filtering stays inside
+ * that border are used, so pictures never bleed into each other.
+ */
+class ImpostorAtlas
+{
+   public:
+    // Pictures taken of each object, evenly spaced around it.
+    static const int Views = 8;
+    // Empty pixels around each picture, and the coarsest mip level that they keep apart.
+    static const int Padding = 4;
+    static const int MaxMipLevel = 3;
+
+    /**
+     * @param instancedProgramID the shader that box instances are drawn with.
+     * @param capacity how many objects the atlas has pictures for. Sized to the mesh cache,
+     *        since objects share an impostor whenever they share a mesh.
+     * @param tileSize width and height in pixels of each picture, a multiple of
+     *        2^MaxMipLevel so that mip levels don't mix tiles.
+     */
+    ImpostorAtlas(GLuint instancedProgramID, int capacity = 256, int tileSize = 64);
+    ~ImpostorAtlas();
+    ImpostorAtlas(const ImpostorAtlas &) = delete;
+    ImpostorAtlas &operator=(const ImpostorAtlas &) = delete;
+
+    /**
+     * Takes pictures of the model's box instances. Changes the bound vertex array, but puts
+     * the framebuffer, viewport and program back how they were.
+     * @return where the impostor goes in model space and its index, which is -1 if the atlas
+     *         is full.
+     */
+    ImpostorInstance add(const Model &model);
+    // Frees an impostor's pictures, so that a later add() can use its tiles.
+    void release(int index) { _free.push_back(index); }
+
+    int size() const { return _count - _free.size(); }
+    int capacity() const { return _capacity; }
+
+    // Binds the atlas and sets the impostor shader's uniforms for drawing ImpostorBatches.
+    void bind(GLuint impostorProgramID, const glm::mat4 &viewProjection,
+              glm::vec3 cameraPosition) const;
+
+   private:
+    GLuint _instancedProgram, _instancedMatrixID;
+    GLuint _texture = 0, _framebuffer = 0, _depthbuffer = 0;
+    int _tileSize, _tilesPerSide;
+    int _count = 0, _capacity = 0;
+    // Released indices below _count, reused first.
+    std::vector<int> _free;
+};
+
+/**
+ * A group of impostors that are drawn together with one instanced draw call.
+ */
+class ImpostorBatch
+{
+   public:
+    void add(const ImpostorInstance &impostor);
+    size_t size() const { return _impostors.size(); }
+    const std::vector<ImpostorInstance> &instances() const { return _impostors; }
+    // Draws every impostor, uploading new ones first. Needs the impostor shader, set up
+    // with ImpostorAtlas::bind().
+    void draw();
+
+    ImpostorBatch() {}
+    ImpostorBatch(const ImpostorBatch &) = delete;
+    ImpostorBatch &operator=(const ImpostorBatch &) = delete;
+    ImpostorBatch(ImpostorBatch &&other);
+    ~ImpostorBatch();
+
+   private:
+    std::vector<ImpostorInstance> _impostors;
+    GLuint _buffer = 0, _vertexArray = 0;
+    bool _dirty = false;
+};
+}
+
+#endif
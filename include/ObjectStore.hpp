@@ -0,0 +1,52 @@
+#ifndef OBJECTSTORE_HPP
+#define OBJECTSTORE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "SceneObjects/SceneObject.hpp"
+
+namespace ParamWorld
+{
+/**
+ * Refers to an object in an ObjectStore. Stays valid while other objects come and go,
+ * and stops finding anything once its own object is removed.
+ */
+struct ObjectHandle {
+    uint32_t index;
+    uint32_t generation;
+
+    bool operator==(const ObjectHandle h) const
+    {
+        return h.index == index && h.generation == generation;
+    }
+};
+
+/**
+ * Owns every SceneObject in the world, each exactly once. Objects are kept in slots that
+ * get reused after removal (a slot map), so handles are small and lookups are O(1).
+ */
+class ObjectStore
+{
+   public:
+    ObjectHandle add(std::unique_ptr<SceneObject> object);
+
+    // The object that handle refers to, or nullptr if it has been removed.
+    SceneObject *get(ObjectHandle handle) const;
+
+    // Removes and destroys the object. Returns false if it was already gone.
+    bool remove(ObjectHandle handle);
+
+    size_t size() const { return _slots.size() - _freeSlots.size(); }
+
+   private:
+    struct Slot {
+        std::unique_ptr<SceneObject> object;
+        uint32_t generation = 0;
+    };
+    std::vector<Slot> _slots;
+    std::vector<uint32_t> _freeSlots;
+};
+}
+
+#endif
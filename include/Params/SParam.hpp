@@ -4,6 +4,7 @@
 #include <math.h>
 #include <algorithm>
 #include <random>
+#include "../Random.hpp"
 
 namespace ParamWorld
 {
@@ -13,14 +14,16 @@ class SParam
     bool isIntegral;
     float min;
     float max;
-    std::mt19937 randomGenerator;
 
     // Generates a uniform valid value using rejection sampling.
     float generateUniform(float randNum);
 
-    // Generates a gaussian valid value using rejection sampling.
-    float generateGaussian(float mean, float variance,
-                           std::normal_distribution<float> unitNormalDistribution);
+    // Generates a gaussian valid value: a normal distribution cut down to [min, max].
+    float generateGaussian(float mean, float variance, Random &random);
+    // The spread of generateGaussian's normal distribution before it's cut down.
+    float sigma(float variance) const { return (max - min) / 2 * variance; }
+    // Rounds a value in range to one that is valid for this param.
+    float valid(float value) const { return isIntegral ? round(value) : value; }
 
     // Constructor
     SParam(bool _isIntegral, float _min, float _max);
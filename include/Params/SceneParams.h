@@ -1,6 +1,7 @@
 #ifndef SceneParams_h
 #define SceneParams_h
 
+#include "../Random.hpp"
 #include "AvailableParameters.h"
 #include "ParamArray.hpp"
 #include "SParam.hpp"
@@ -32,20 +33,21 @@ class SceneParams
     ParamArray<SP_Count> onlineMean = ParamArray<SP_Count>(0.0f);
     ParamArray<SP_Count> onlineM2 = ParamArray<SP_Count>(0.0f);
 
-    // Random number generators
-    std::default_random_engine randomGenerator;
-    std::uniform_real_distribution<float> unitUniformDistribution{};
-    std::normal_distribution<float> unitNormalDistribution{};
+    // Random number generator for randomSP(), seeded by the constructor.
+    Random randomGenerator = Random(0);
 
     // Available Parameters
     SParam **AllParams = (SParam **)malloc(SP_Count * sizeof(SParam *));
+    // The range of values a param can have, the same for every SceneParams.
+    static const SParam &definition(int param);
 
     // The current global "mean" parameter vector
     ParamArray<SP_Count> paramMeans;
     ParamArray<SP_Count> paramVariances = ParamArray<SP_Count>(1.0f);
 
-    // deviance is a multiplier applied to the variance of each parameter
-    ParamArray<SP_Count> generate(float deviance);
+    // deviance is a multiplier applied to the variance of each parameter. The same random
+    // generator (and means) always gives the same params.
+    ParamArray<SP_Count> generate(float deviance, Random &random);
 
     // Total random (valid) parameter
     ParamArray<SP_Count> randomSP();
@@ -65,8 +67,10 @@ class SceneParams
     /*
     * Constructor and Destructor
     */
+    // Seeded with the time.
     SceneParams();
-    SceneParams(unsigned int seed);
+    // Starts from means picked with seed, so the same seed gives the same starting world.
+    SceneParams(uint64_t seed);
     ~SceneParams()=default;
 };
 }
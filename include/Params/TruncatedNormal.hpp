@@ -0,0 +1,22 @@
+#ifndef TRUNCATEDNORMAL_HPP
+#define TRUNCATEDNORMAL_HPP
+
+#include "../Random.hpp"
+
+namespace ParamWorld
+{
+// The standard normal distribution's CDF, accurate far into the lower tail.
+double normalCdf(double x);
+// Its inverse, for p in (0, 1).
+double inverseNormalCdf(double p);
+
+/**
+ * Draws a value from a normal distribution with mean and sigma that is cut down to
+ * [low, high]. Works by inverting the CDF, so it takes exactly one uniform number from random
+ * however little of the distribution is left in the range; no rejection loops. Means outside
+ * of the range are fine. A zero sigma gives the mean, clamped.
+ */
+float sampleTruncatedNormal(float mean, float sigma, float low, float high, Random &random);
+}
+
+#endif
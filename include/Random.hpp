@@ -0,0 +1,54 @@
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <cstdint>
+#include <limits>
+
+namespace ParamWorld
+{
+/**
+ * A counter-based random number generator (SplitMix64). Each value is a hash of the seed and
+ * how many values came before it, so there's no shared state to lock: generators for parts of
+ * the world are made from the world seed with child(), and the same seed gives the same values
+ * on any thread, in any order.
+ *
+ * Also meets the UniformRandomBitGenerator requirements, for use with std:: distributions.
+ */
+class Random
+{
+   public:
+    typedef uint64_t result_type;
+
+    explicit Random(uint64_t seed) : _seed(seed) {}
+
+    // An independent generator for one of the things this one makes, numbered by index.
+    // For example, Random(worldSeed).child(square.x).child(square.z).child(objectIndex).
+    Random child(uint64_t index) const { return Random(mix(_seed ^ mix(index + Increment))); }
+
+    uint64_t next() { return mix(_seed + Increment * ++_counter); }
+    // Uniform in [0, 1).
+    float uniform() { return (next() >> 40) * (1.0f / (uint64_t(1) << 24)); }
+    // Uniform in [0, n), for n > 0.
+    int below(int n) { return static_cast<int>(((next() >> 32) * uint64_t(n)) >> 32); }
+
+    result_type operator()() { return next(); }
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+   private:
+    static const uint64_t Increment = 0x9e3779b97f4a7c15ull;
+
+    // The SplitMix64 finalizer: every bit of z affects every bit of the result.
+    static uint64_t mix(uint64_t z)
+    {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t _seed;
+    uint64_t _counter = 0;
+};
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef BOUNDS_HPP
+#define BOUNDS_HPP
+
+#include <algorithm>
+#include <limits>
+#include "headers.hpp"
+
+namespace ParamWorld
+{
+/**
+ * An axis aligned bounding box. Starts out empty, and grows to fit every point and
+ * box that is added to it.
+ */
+struct Bounds {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    bool empty() const { return min[0] > max[0]; }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    // Radius of the bounding sphere around center().
+    float radius() const { return glm::length(max - min) * 0.5f; }
+
+    // Distance from point to the closest part of the box, or 0 if it's inside.
+    float distanceTo(glm::vec3 point) const
+    {
+        glm::vec3 outside(0, 0, 0);
+        for (int i = 0; i < 3; i++) {
+            outside[i] = std::max(std::max(min[i] - point[i], point[i] - max[i]), 0.0f);
+        }
+        return glm::length(outside);
+    }
+
+    void extend(glm::vec3 point)
+    {
+        for (int i = 0; i < 3; i++) {
+            min[i] = std::min(min[i], point[i]);
+            max[i] = std::max(max[i], point[i]);
+        }
+    }
+
+    void extend(const Bounds &other)
+    {
+        if (!other.empty()) {
+            extend(other.min);
+            extend(other.max);
+        }
+    }
+
+    Bounds translated(glm::vec3 offset) const
+    {
+        Bounds moved;
+        if (!empty()) {
+            moved.min = min + offset;
+            moved.max = max + offset;
+        }
+        return moved;
+    }
+};
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef FACENORMALS_HPP
+#define FACENORMALS_HPP
+
+#include "Model.hpp"
+
+namespace ParamWorld
+{
+/**
+ * Sets the normal of every vertex of each of the triangleCount triangles in indices to the
+ * triangle's unit normal, (b - a) x (c - a), or to +y if the triangle has no area.
+ *
+ * Triangles are gathered four at a time into x, y and z lanes and worked on with SIMD.
+ * The rest go through faceNormalsScalar(), which gives the same results one at a time.
+ */
+void faceNormals(Vertex *vertices, const GLuint *indices, size_t triangleCount);
+void faceNormalsScalar(Vertex *vertices, const GLuint *indices, size_t triangleCount);
+}
+
+#endif
@@ -1,65 +1,78 @@
 #ifndef FUNCTION_HPP
 #define FUNCTION_HPP
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <limits>
 
 namespace ParamWorld
 {
 
 /**
- * A function that returns a y value for a particular x value.
+ * A function that returns a y value for a particular x value. It's one of a few kinds, all of
+ * the form f(rate * (x - offset)), and is kept by value so lots of them fit in flat arrays
+ * (see AnimationTable).
  */
-class Function
-{
-   public:
-    virtual double at(double x) const = 0;
-    virtual ~Function()=default;
-};
+struct Function {
+    enum Kind : uint8_t {
+        // Always returns 1.0, despite of the current x.
+        Constant,
+        // Linear/constant piecewise: 0.0 at offset, rising to 1.0 and staying there.
+        Linear,
+        // A logistic function approaching 1.0, centered on offset.
+        Logistic
+    };
+    Kind kind = Constant;
+    double offset = 0.0;
+    double rate = 0.0;
 
-/**
- * Always returns 1.0, despite of the current x.
- */
-class Constant : public Function
-{
-   public:
-    double at(double /*unused*/) const { return 1.0; }
-    Constant()=default;
-};
+    Function() = default;
+    static Function constant() { return Function(); }
+    /**
+     * @param root when x = root, y is 0.0
+     * @param oneIntersect when x = oneIntersect, y is 1.0.
+     * In between root and oneIntersect, y is a linear interpolation between 0 and 1.
+     */
+    static Function linear(double root, double oneIntersect)
+    {
+        return Function(Linear, root, 1 / (oneIntersect - root));
+    }
+    static Function logistic(double midpoint, double steepness)
+    {
+        return Function(Logistic, midpoint, steepness);
+    }
 
-/**
- * A function that is a linear/constart piecewise.
- */
-class Linear : public Function
-{
-   public:
-   /**
-    * @brief Constructor
-    * @param root when x = root, y is 0.0
-    * @param oneIntersect when x = oneIntersect, y is 1.0.
-    * In between root and oneIntersect, y is a linear interpolation between 0 and 1.
-    */
-    Linear(double root, double oneIntersect) : _root(root), _oneIntersect(oneIntersect) {}
-    ~Linear()=default;
-    double at(double x) const 
+    double at(double x) const { return atScaled(kind, rate * (x - offset)); }
+    /**
+     * @return true if the function has (for drawing purposes) stopped changing at x and
+     * will return 1.0 from then on.
+     */
+    bool saturated(double x) const { return rate * (x - offset) >= saturationPoint(kind); }
+
+    // The function's value given u = rate * (x - offset).
+    static double atScaled(Kind kind, double u)
     {
-        return std::fmin((x - _root) * (1 / (_oneIntersect - _root)), 1.0);
+        switch (kind) {
+            case Linear:
+                return std::min(u, 1.0);
+            case Logistic:
+                return 1 / (1 + std::exp(-u));
+            default:
+                return 1.0;
+        }
+    }
+    // The u = rate * (x - offset) from which the function counts as saturated. A logistic
+    // is never exactly 1.0, but past 0.999 snapping to it isn't visible.
+    static double saturationPoint(Kind kind)
+    {
+        static const double points[] = {-std::numeric_limits<double>::infinity(), 1.0,
+                                        std::log(999.0)};
+        return points[kind];
     }
-   private:
-    double _root;
-    double _oneIntersect;
-};
 
-/**
- * A logistic function, approaching 1.0.
- */
-class Logistic : public Function
-{
-   public:
-    Logistic(double midpoint, double steepness) : _midpoint(midpoint), _steepness(steepness) {}
-    double at(double x) const { return 1 / (1 + exp(-_steepness * (x - _midpoint))); }
    private:
-    double _midpoint;
-    double _steepness;
+    Function(Kind kind, double offset, double rate) : kind(kind), offset(offset), rate(rate) {}
 };
 }
 
@@ -0,0 +1,103 @@
+#ifndef MESHCACHE_HPP
+#define MESHCACHE_HPP
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "SceneObject.hpp"
+
+namespace ParamWorld
+{
+/**
+ * What an object looks like: its shape params, each rounded to a whole number of steps, so
+ * that objects whose params are close enough get the same key.
+ */
+struct MeshKey {
+    static const int MaxValues = 16;
+
+    std::array<int32_t, MaxValues> values;
+    int count = 0;
+
+    MeshKey() { values.fill(0); }
+    // Rounds value to the nearest multiple of step in [min, max], adds that to the key and
+    // returns it. If no multiple is in range, value is clamped to it instead.
+    float quantize(float value, float step, float min, float max);
+    bool operator==(const MeshKey &other) const
+    {
+        return count == other.count && values == other.values;
+    }
+};
+}
+
+namespace std
+{
+template <>
+struct hash<ParamWorld::MeshKey> {
+    size_t operator()(const ParamWorld::MeshKey &key) const
+    {
+        size_t h = std::hash<int>()(key.count);
+        for (int i = 0; i < key.count; i++) {
+            h = h * 31 + std::hash<int32_t>()(key.values[i]);
+        }
+        return h;
+    }
+};
+}
+
+namespace ParamWorld
+{
+/**
+ * Shares meshes between objects that look the same, so only the first of them is built and
+ * uploaded. Keeps the capacity() most recently used meshes alive even when no object is using
+ * them, since objects let go of theirs once they are baked into a chunk.
+ * Safe to use from several threads at once. Meshes own GL buffers, so the ones it drops are
+ * only freed by freeRetired(), on the thread with the GL context.
+ */
+class MeshCache
+{
+   public:
+    explicit MeshCache(size_t capacity = 256) : _capacity(capacity) {}
+
+    /**
+     * The mesh for key, made with build() if there isn't one yet. build() runs without the
+     * cache locked, so two threads can build the same missing mesh; the first one to finish
+     * is kept and given to both.
+     */
+    std::shared_ptr<Mesh> get(const MeshKey &key,
+                              const std::function<std::shared_ptr<Mesh>()> &build);
+
+    // Zero turns caching off.
+    void setCapacity(size_t capacity);
+    size_t capacity() const;
+    void clear();
+    // Frees the meshes dropped since the last call that no object is using any more.
+    void freeRetired();
+
+    size_t size() const;
+    // Number of get() calls that found a mesh, and that had to build one.
+    size_t hits() const;
+    size_t misses() const;
+
+   private:
+    // Most recently used first.
+    typedef std::list<std::pair<MeshKey, std::shared_ptr<Mesh>>> Entries;
+
+    // Drops the least recently used meshes until there are at most _capacity.
+    void trim();
+
+    mutable std::mutex _mutex;
+    Entries _entries;
+    std::unordered_map<MeshKey, Entries::iterator> _index;
+    std::vector<std::shared_ptr<Mesh>> _retired;
+    size_t _capacity;
+    size_t _hits = 0, _misses = 0;
+};
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef MESHOPTIMIZER_HPP
+#define MESHOPTIMIZER_HPP
+
+#include <vector>
+#include "Model.hpp"
+
+namespace ParamWorld
+{
+/**
+ * Points the indices of vertices that are exactly the same (position, color and normal) at
+ * the first of them. Returns how many vertices are no longer used; optimizeVertexFetch()
+ * drops them.
+ */
+size_t weldVertices(const Vertex *vertices, size_t vertexCount, GLuint *indices,
+                    size_t indexCount);
+
+/**
+ * Reorders the triangles so that each vertex is used again while it's still in a FIFO
+ * post-transform cache of cacheSize vertices (Tipsify: fan around a vertex, then move on to
+ * one of its neighbours that will still be cached).
+ *
+ * If clusters isn't null, the index of the first triangle of each cluster is written to it,
+ * for optimizeOverdraw(). Clusters start wherever the order starts again with a cold cache,
+ * and also wherever the triangles since the last start have missed the cache at most
+ * threshold times as often as their whole run does (Tipsify's lambda). Starting those again
+ * from a cold cache, once they're reordered, then costs little.
+ */
+void optimizeVertexCache(GLuint *indices, size_t indexCount, size_t vertexCount, int cacheSize,
+                         std::vector<size_t> *clusters = nullptr, float threshold = 1.05f);
+
+/**
+ * Reorders the clusters of triangles (as written by optimizeVertexCache()) so that those
+ * facing out from the middle of the mesh come first. From most directions they're in front
+ * of the rest, so drawing them first lets the depth test skip more of what they hide.
+ */
+void optimizeOverdraw(const Vertex *vertices, GLuint *indices, size_t indexCount,
+                      const std::vector<size_t> &clusters);
+
+// Renumbers the vertices in the order the indices first use them, dropping unused ones.
+void optimizeVertexFetch(std::vector<Vertex> &vertices, GLuint *indices, size_t indexCount);
+
+/**
+ * The average number of vertices transformed per triangle when drawing indices through a
+ * FIFO post-transform cache of cacheSize vertices. 3 is no reuse at all, and a large
+ * smooth mesh can get close to 0.5.
+ */
+float averageCacheMissRatio(const GLuint *indices, size_t indexCount, size_t vertexCount,
+                            int cacheSize = 16);
+}
+
+#endif
@@ -2,40 +2,212 @@
 #define MODEL_HPP
 
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/transform.hpp>
 #include <vector>
+#include "Bounds.hpp"
 #include "Color.hpp"
 #include "headers.hpp"
 
 namespace ParamWorld
 {
-    
+
+/**
+ * A single interleaved vertex. The color is packed as normalized RGBA8, and the
+ * normal as a normalized signed 10-10-10-2 integer, so a vertex is 20 bytes.
+ */
+struct Vertex {
+    glm::vec3 position;
+    GLuint color;
+    GLuint normal;
+};
+
+/**
+ * A vertex in the compact format, which is 12 bytes: the position as half floats measured
+ * from the model's origin, the normal octahedral encoded into two signed bytes, and the
+ * color as normalized RGBA8.
+ */
+struct CompactVertex {
+    GLushort position[3];
+    GLushort normal;
+    GLuint color;
+};
+
+// How a model stores and uploads its vertices.
+enum class VertexFormat { Full, Compact };
+
+/**
+ * One box drawn through instancing: a unit cube scaled by size, rotated and moved to center.
+ * The rotation quaternion is stored as (x, y, z, w), and the color as normalized RGBA8.
+ */
+struct BoxInstance {
+    glm::vec3 center;
+    glm::vec3 size;
+    glm::vec4 rotation;
+    GLuint color;
+};
+
 /**
  * The graphics model for objects to be rendered. Handles the specific
  * vertex, color and normal information.
+ *
+ * Vertices are stored interleaved in one buffer and drawn through an index
+ * buffer. Each flat face only stores its unique corners, so a box is 24
+ * vertices and 36 indices.
+ *
+ * Boxes can also be added as instances, which are only 44 bytes each and are
+ * drawn all at once against one shared unit cube.
+ *
+ * Models that are done being built can switch to the compact vertex format to take up
+ * less memory. Compact positions are stored relative to the model's origin, so such
+ * models need to be drawn with an extra translation by origin().
  */
 class Model
 {
    public:
+    // The kinds of primitive that reserve() can make room for.
+    enum class Primitive { Box, Tetra, Triangle, BoxInstance };
+    // Which faces of a tetra AddTetra() adds: the ones that meet at the top, the one opposite
+    // it, or all four. Faces that are covered by other shapes can be left out.
+    enum class TetraFaces { All, Sides, Base };
+
+    // Uploads the current geometry. Can be called again to re-upload after adding more.
     void InitBuffer();
+    /**
+     * Sizes the GL buffers for the current geometry without filling them, so that the data
+     * can be streamed in over a few frames with uploadSome(). Geometry shouldn't be added
+     * until uploaded() is true.
+     */
+    void beginUpload();
+    // Uploads up to maxBytes more of the geometry. Returns how many bytes were sent.
+    size_t uploadSome(size_t maxBytes);
+    /**
+     * Like uploadSome(), for a model that has had geometry appended since it was uploaded:
+     * only the new geometry is sent. Buffers that are too small grow by doubling, keeping
+     * what they hold with a copy on the GPU. Until everything has arrived, the model draws
+     * what had already been uploaded.
+     */
+    size_t uploadAppended(size_t maxBytes);
+    bool uploaded() const;
+    // Total bytes of vertex, index and instance data.
+    size_t uploadSize() const;
+    // Draws the triangles. Like drawInstances(), this leaves the model's vertex array bound,
+    // so anything drawn without a Model afterwards needs to bind its own.
     void drawBuffer() const;
+    // Draws all box instances against the shared unit cube. Needs the instanced shader.
+    void drawInstances() const;
     void AddBoxFromCorner(float x1, float y1, float z1, float x2, float y2, float z2, Color c);
     void AddBoxFromCorner(Color c, glm::vec3 origin, glm::vec3 size);
     void AddBoxFromCenter(Color c, glm::vec3 origin, glm::vec3 size);
-    void AddTetra(Color color, glm::vec3 top, glm::vec3 l, glm::vec3 r, glm::vec3 b);
+    void AddTetra(Color color, glm::vec3 top, glm::vec3 l, glm::vec3 r, glm::vec3 b,
+                  TetraFaces faces = TetraFaces::All);
     void AddBoxFromCenter(Color c, glm::vec3 center, glm::vec3 size, glm::fquat rotation);
+    // Adds a box that is drawn as an instance of the unit cube instead of as triangles.
+    void AddBoxInstance(Color c, glm::vec3 center, glm::vec3 size, glm::fquat rotation);
+    // Adds count already built instances at once, e.g. ones filled in by several threads.
+    void AddBoxInstances(const BoxInstance *instances, size_t count);
+    static BoxInstance MakeBoxInstance(Color c, glm::vec3 center, glm::vec3 size,
+                                       glm::fquat rotation);
+    // Axis aligned box around a turned box instance.
+    static Bounds boundsOf(const BoxInstance &instance);
+    // Makes room for count more primitives of a kind, so that building a model whose size is
+    // known up front allocates once instead of growing as it goes.
+    void reserve(Primitive kind, size_t count);
+    /**
+     * Converts the vertices to the given format. Compact positions are kept relative to
+     * origin, which should be within a few units of all of the geometry for half floats to
+     * hold it precisely.
+     */
+    void setVertexFormat(VertexFormat format, glm::vec3 origin = glm::vec3(0, 0, 0));
+    /**
+     * Makes the triangles cheaper to draw without changing them: welds duplicate vertices,
+     * orders the triangles for a post-transform cache of cacheSize vertices and then roughly
+     * outside in, and stores the vertices in the order they're used (see MeshOptimizer.hpp).
+     * Only full models are optimized, before they're uploaded.
+     */
+    void optimize(int cacheSize = 16);
+    /**
+     * Puts off working out the normals of full models' boxes and tetras until fillNormals(),
+     * which does all of them in one pass instead of a few triangles per shape. Every triangle
+     * added in between gets its face's normal. Uploading, optimizing or changing the format
+     * fills them in first.
+     */
+    void deferNormals();
+    void fillNormals();
+    VertexFormat vertexFormat() const { return _format; }
+    // Where compact positions are measured from. Zero for full models.
+    glm::vec3 origin() const { return _origin; }
+    // Appends all of other's geometry, moved into this model's space by transform, which
+    // should be rigid (only a rotation and translation).
+    void Append(const Model &other, const glm::mat4 &transform);
+
+    size_t vertexCount() const
+    {
+        return (_format == VertexFormat::Full) ? _vertices.size() : _compactVertices.size();
+    }
+    // The i-th vertex in model space, unpacked if the model is compact.
+    Vertex vertex(size_t i) const;
+    size_t indexCount() const { return _indices.size(); }
+    // Only filled in for full models.
+    const std::vector<Vertex> &vertices() const { return _vertices; }
+    // Only filled in for compact models.
+    const std::vector<CompactVertex> &compactVertices() const { return _compactVertices; }
+    const std::vector<GLuint> &indices() const { return _indices; }
+    size_t instanceCount() const { return _instances.size(); }
+    const std::vector<BoxInstance> &instances() const { return _instances; }
+    // Box around all of the model's triangles and instances, in model space.
+    const Bounds &bounds() const { return _bounds; }
 
     Model() {}
+    // Models own their GL buffers, so they can be moved but not copied.
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+    Model(Model &&other);
+    Model &operator=(Model &&other);
+    ~Model();
    protected:
-    uint16_t AddVertex(float x, float y, float z, const Color& c);
+    GLuint AddVertex(glm::vec3 position, GLuint color, GLuint normal);
 
    private:
-    GLuint _vertexbuffer, _colorbuffer, _normalbuffer;
-    std::vector<GLfloat> _vertices;
-    std::vector<GLfloat> _colors;
-    std::vector<GLfloat> _normals;
+    // Adds a box given its 8 corners, where bit 0/1/2 of the index selects +x/+y/+z.
+    void AddBox(const glm::vec3 corners[8], Color c);
+    // Adds a flat face (3 or 4 corners in cyclic order), counter-clockwise unless flipped.
+    // Leaves the normals of full models for faceNormals() to fill in.
+    void AddFace(const glm::vec3 *corners, int count, bool flip, GLuint color);
+    void extendBounds(const BoxInstance &instance);
+    // Point the vertex arrays at the buffers, so drawing is just a bind and a draw call.
+    void setupVertexArray();
+    void setupInstanceArray();
+    const void *vertexData() const;
+    size_t vertexBytes() const;
+    // The GL buffers are the vertices, the indices and the instances, in that order.
+    size_t partBytes(int part) const;
+    const char *partData(int part) const;
+    GLuint &partBuffer(int part);
+    // Makes each buffer big enough for its part, for uploadAppended().
+    void growBuffers();
+
+    // The cube that all box instances are drawn with.
+    static const Model &unitCube();
+
+    GLuint _vertexbuffer = 0, _indexbuffer = 0, _instancebuffer = 0;
+    // Made along with the buffers in beginUpload(); one for the triangles, one for instances.
+    GLuint _vertexArray = 0, _instanceArray = 0;
+    VertexFormat _format = VertexFormat::Full;
+    glm::vec3 _origin = glm::vec3(0, 0, 0);
+    std::vector<Vertex> _vertices;
+    std::vector<CompactVertex> _compactVertices;
+    std::vector<GLuint> _indices;
+    std::vector<BoxInstance> _instances;
+    Bounds _bounds;
+    // Triangles from _normalsFrom on have no normals yet, while deferNormals() is on.
+    bool _deferNormals = false;
+    size_t _normalsFrom = 0;
+    // For each buffer: how big it is, and how much of its part has been uploaded to it.
+    size_t _bufferBytes[3] = {0, 0, 0};
+    size_t _sentBytes[3] = {0, 0, 0};
 };
 }
 
@@ -3,10 +3,12 @@
 
 #include <math.h>
 #include <algorithm>
+#include <atomic>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/transform.hpp>
+#include "../Random.hpp"
 #include "Color.hpp"
 #include "SceneObject.hpp"
 #include "headers.hpp"
@@ -18,19 +20,51 @@ namespace ParamWorld
 class RockObject : public SceneObject
 {
    public:
-    // Forces it to be on the ground.
+    // Forces it to be on the ground. Rocks made with the same seed have the same shape.
     RockObject(int depth, Color color, glm::vec3 root, glm::vec2 a, glm::vec2 b, glm::vec2 c,
-               float heightMult);
+               float heightMult, uint64_t seed = 0);
 
     // Inits the rock object with randomly generated scene params.
-    RockObject(glm::vec3 root, glm::vec2 a, glm::vec2 b, glm::vec2 c, ParamArray<SP_Count> params);
+    RockObject(glm::vec3 root, glm::vec2 a, glm::vec2 b, glm::vec2 c, ParamArray<SP_Count> params,
+               uint64_t seed = 0);
+
+    /**
+     * Whether rocks keep every face of every tetra, instead of only their surface (the
+     * default). Each tetra is built outward on a side of the one before, so those two faces
+     * are always inside the rock. Only there for comparing the two. Each rock reads it once,
+     * so changing it while others are building only affects the rocks made after.
+     */
+    static void setKeepHiddenFaces(bool keep) { keepHiddenFaces = keep; }
+    // Whether rocks run Model::optimize() on their models (the default), for comparing. Safe
+    // to change while rocks are being built on other threads.
+    static void setOptimizeMeshes(bool optimize) { optimizeMeshes = optimize; }
 
    private:
+    static std::atomic<bool> keepHiddenFaces;
+    static std::atomic<bool> optimizeMeshes;
+
     int _depth;
+    // keepHiddenFaces, as it was when this rock started building.
+    bool _keepHiddenFaces;
     float _heightMult;
     Color _color1, _color2, _color3;
+    // Picks where each tetra's point goes, and its shade.
+    Random _random;
+
+    // Number of tetras in a rock with the given depth: 1 + 3 + ... + 3^depth.
+    static size_t tetraCount(int depth);
+    // Number of triangles on the surface of a rock with the given depth: the sides of the
+    // 3^depth tetras at the bottom, and the base.
+    static size_t surfaceCount(int depth);
 
+    // Builds the rock and its levels of detail on the triangle a, b, c.
+    void Build(glm::vec3 a, glm::vec3 b, glm::vec3 c);
     void Init(int depth, glm::vec3 a, glm::vec3 b, glm::vec3 c);
+    /**
+     * Adds a tetra on a, b, c to the models that go depth more levels down, and returns its
+     * top. Only the faces on the rock's surface are added, unless _keepHiddenFaces.
+     */
+    glm::vec3 AddTetraOn(int depth, glm::vec3 a, glm::vec3 b, glm::vec3 c);
 
     glm::vec3 sampleInTri(glm::vec3 a, glm::vec3 b, glm::vec3 c);
 };
@@ -3,6 +3,11 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/transform.hpp>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "../ImpostorAtlas.hpp"
 #include "../Params/AvailableParameters.h"
 #include "../Params/ParamArray.hpp"
 #include "Color.hpp"
@@ -12,34 +17,110 @@
 
 namespace ParamWorld
 {
+/**
+ * The geometry of an object at every level of detail. Objects that look the same share one
+ * (see MeshCache), so it is only built, uploaded and pictured once.
+ */
+struct Mesh {
+    Model model;
+    // Cheaper versions of model for drawing from further away, finest first.
+    std::vector<Model> lods;
+    bool uploadStarted = false;
+    // Its picture in the world's ImpostorAtlas, once it has one.
+    ImpostorInstance impostor = {glm::vec3(0, 0, 0), 0.0f, -1};
+};
+
 class SceneObject
 {
    public:
     ParamArray<SP_Count> params;
     glm::vec3 rootPosition;
 
-    void init() { m.InitBuffer(); }
+    void init()
+    {
+        beginUpload();
+        uploadSome(std::numeric_limits<size_t>::max());
+    }
+    // Like init(), but spread over several calls (see Model::beginUpload). A shared mesh is
+    // only started once, and any of the objects sharing it can carry on its upload.
+    void beginUpload()
+    {
+        if (mesh->uploadStarted) {
+            return;
+        }
+        mesh->model.beginUpload();
+        for (Model &lod : mesh->lods) {
+            lod.beginUpload();
+        }
+        mesh->uploadStarted = true;
+    }
+    size_t uploadSome(size_t maxBytes)
+    {
+        size_t sent = mesh->model.uploadSome(maxBytes);
+        for (Model &lod : mesh->lods) {
+            sent += lod.uploadSome(maxBytes - sent);
+        }
+        return sent;
+    }
+    bool isUploaded() const
+    {
+        for (const Model &lod : mesh->lods) {
+            if (!lod.uploaded()) {
+                return false;
+            }
+        }
+        return mesh->model.uploaded();
+    }
     virtual glm::mat4 calcModelMatrix()
     {
-        double sizeNow = size->at(glfwGetTime());
+        double sizeNow = size.at(glfwGetTime());
         return glm::translate(rootPosition) *
                glm::scale(glm::mat4(1.0f), glm::vec3(sizeNow, sizeNow, sizeNow));
     }
-    void draw() { m.drawBuffer(); };
-    SceneObject(ParamArray<SP_Count> params, glm::vec3 rootPos, Function *f)
-        : params(params), size(f), rootPosition(rootPos)
+    void draw(int lod = 0) { getModel(lod).drawBuffer(); };
+    // Draws the boxes of the object that are instanced. Needs the instanced shader.
+    void drawInstances(int lod = 0) { getModel(lod).drawInstances(); }
+    // True once the object has finished growing and its model matrix is a plain translation.
+    bool isGrown() const { return size.saturated(glfwGetTime()); }
+    // How the object scales up from nothing as it grows, over glfwGetTime().
+    const Function &growth() const { return size; }
+    // Skips the growing, so the object is at its full size from the start.
+    void finishGrowing() { size = Function::constant(); }
+    // Number of levels of detail: the full model, and then each of the coarser ones.
+    int lodCount() const { return 1 + mesh->lods.size(); }
+    // The model at a level of detail, where 0 is the full model. Objects with fewer levels
+    // give their coarsest one.
+    const Model &getModel(int lod = 0) const
+    {
+        lod = std::min(lod, lodCount() - 1);
+        return (lod <= 0) ? mesh->model : mesh->lods[lod - 1];
+    }
+    const std::shared_ptr<Mesh> &getMesh() const { return mesh; }
+    // Lets go of the geometry once it has been baked somewhere else. It's freed, on the CPU
+    // and GPU, when no other object or cache shares it.
+    void releaseModel() { mesh = std::make_shared<Mesh>(); }
+    // World space box that holds the object at any point while it grows.
+    Bounds worldBounds() const
     {
+        Bounds b = mesh->model.bounds();
+        b.extend(glm::vec3(0, 0, 0));  // growing scales the model towards its root.
+        return b.translated(rootPosition);
     }
-    SceneObject(ParamArray<SP_Count> params, glm::vec3 rootPos)
-        : params(params), size(new Constant()), rootPosition(rootPos)
+    SceneObject(ParamArray<SP_Count> params, glm::vec3 rootPos,
+                Function f = Function::constant())
+        : params(params), size(f), rootPosition(rootPos), mesh(std::make_shared<Mesh>())
     {
     }
+    // Objects own their geometry, so they can be moved but not copied.
+    SceneObject(SceneObject &&) = default;
+    SceneObject &operator=(SceneObject &&) = default;
+    virtual ~SceneObject() = default;
 
    protected:
-    Model m;
+    std::shared_ptr<Mesh> mesh;
 
    private:
-    Function *size;
+    Function size;
 };
 
 // A single scene object that should just contain large swaths of a skinny box.
@@ -48,7 +129,7 @@ class Ground : public SceneObject
    public:
     Ground(float width) : SceneObject(ParamArray<SP_Count>(), glm::vec3(0, 0, 0))
     {
-        m.AddBoxFromCenter(groundColor, glm::vec3(0, 0, 0), glm::vec3(width, 0.01f, width));
+        mesh->model.AddBoxFromCenter(groundColor, glm::vec3(0, 0, 0), glm::vec3(width, 0.01f, width));
     }
 
    private:
@@ -6,6 +6,7 @@
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/transform.hpp>
+#include "../Random.hpp"
 #include "SceneObject.hpp"
 
 namespace ParamWorld
@@ -21,7 +22,8 @@ class SkyObject : public SceneObject
         return glm::rotate(skyTurn, glm::vec3(1, 0, 0));
     }
 
-    SkyObject(int starCount, glm::vec3 origin, float dist);
+    // Stars are placed using seed, so the same seed gives the same sky.
+    SkyObject(int starCount, glm::vec3 origin, float dist, uint64_t seed = 0);
 
    private:
     double lastTime;
@@ -2,6 +2,8 @@
 #define TREEOBJECT_HPP
 
 #include <stdio.h>
+#include <atomic>
+#include <cstdint>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
@@ -12,8 +14,10 @@
 #include "../Params/AvailableParameters.h"
 #include "../Params/ParamArray.hpp"
 #include "Color.hpp"
+#include "MeshCache.hpp"
 #include "Model.hpp"
 #include "SceneObject.hpp"
+#include "../TaskPool.hpp"
 #include "headers.hpp"
 
 namespace ParamWorld
@@ -24,27 +28,104 @@ class TreeObject : public SceneObject
     TreeObject(glm::vec3 root, int depth, float height, float width, float scale, float angle,
                Color leafColor, Color trunkColor, float leafSize);
 
-    TreeObject(glm::vec3 root, ParamArray<SP_Count> params)
-        : SceneObject(params, root, new Logistic(glfwGetTime() + 6.0, 1.0)),
-          _depth((int)params[SP_Depth]),
-          _height(params[SP_Height]),
-          _width(params[SP_Width]),
-          _scale(params[SP_Scale]),
-          _splitAngle(params[SP_SplitAngle]),
-          _leafColor(params[SP_LeafR], params[SP_LeafG], params[SP_LeafB]),
-          _trunkColor(params[SP_BranchR], params[SP_BranchG], params[SP_BranchB]),
-          _leafSize(params[SP_LeafSize])
-    {
-        initModels(glm::vec3(0, 0, 0), glm::vec3(_width, _height, _width), _depth,
-                   glm::angleAxis(0.0f, glm::vec3(0, 1, 0)));
-    }
+    /**
+     * A tree shaped by params. With a cache, the shape params are rounded to steps first, and
+     * trees that round the same way share one mesh.
+     */
+    TreeObject(glm::vec3 root, ParamArray<SP_Count> params, MeshCache *cache = nullptr);
+    /**
+     * Rounds the params that shape a tree to steps, staying inside each param's range, and
+     * adds the steps to key if given.
+     */
+    static ParamArray<SP_Count> quantizeShape(ParamArray<SP_Count> params,
+                                              MeshKey *key = nullptr);
+
+    /**
+     * How many levels from the trunk down are placed before the subtrees under them are handed
+     * to the shared TaskPool; 0 builds every tree on the calling thread. Each tree reads it
+     * once, so changing it while others are building only affects the trees made after.
+     */
+    static void setParallelLevels(int levels) { parallelLevels = levels; }
 
    private:
     int _depth;
     float _height, _width, _scale, _splitAngle, _leafSize;
     Color _leafColor, _trunkColor;
 
-    void initModels(glm::vec3 root, glm::vec3 dims, int depth, glm::fquat rotation);
+    static std::atomic<int> parallelLevels;
+
+    // Built with the shape params, which are the params rounded when there's a cache.
+    TreeObject(glm::vec3 root, ParamArray<SP_Count> params, ParamArray<SP_Count> shape,
+               MeshCache *cache);
+
+    /**
+     * Every branch with the same number of levels under it has the same shape, only moved
+     * and turned, so the tree is worked out as one of these per level (a DAG) and the boxes
+     * are placed from them.
+     */
+    struct Level {
+        // Everything in a branch sits along its own y axis: its box (or leaf at level 0), and
+        // where both child branches start. These are measured with the branch unturned.
+        float centerY, childY;
+        glm::vec3 size;
+        // How the child branches are turned, relative to this one.
+        glm::fquat left, right;
+    };
+
+    /**
+     * The branches of a subtree in level order, as one array per field, so that a whole
+     * level is worked out in one pass over contiguous memory. Level k is at [2^k - 1,
+     * 2^(k+1) - 1), and the children of the i-th branch of a level are the i-th branches of
+     * the first and second halves of the next. slot is where a branch's box goes in out (see
+     * placeTree()). The arrays never overlap, which __restrict tells the compiler.
+     */
+    struct LevelOrder {
+        float *__restrict x, *__restrict y, *__restrict z;
+        float *__restrict qw, *__restrict qx, *__restrict qy, *__restrict qz;
+        uint32_t *__restrict slot;
+
+        void set(size_t i, glm::vec3 root, glm::fquat rotation, uint32_t boxSlot);
+        // The same arrays, starting from the i-th branch.
+        LevelOrder at(size_t i) const
+        {
+            return {x + i, y + i, z + i, qw + i, qx + i, qy + i, qz + i, slot + i};
+        }
+    };
+    // Room for the LevelOrder of a subtree of any depth.
+    struct LevelOrderVectors;
+
+    // Number of boxes in a (sub)tree with the given depth.
+    static constexpr size_t boxCount(int depth) { return (size_t(2) << depth) - 1; }
+
+    void buildModels();
+    // Makes the model and its levels of detail out of the boxes laid out as in placeTree().
+    void addModels(const BoxInstance *boxes, size_t count);
+    // Fills in the _depth + 1 levels of this tree, indexed by the number of levels under them.
+    void buildLevels(Level *levels) const;
+    /**
+     * Adds the boxes of the subtree to lod, but with every subtree that is only dropped levels
+     * deep replaced by one leaf colored box around it. boxes is laid out as in placeTree().
+     */
+    void addLodBoxes(const BoxInstance *boxes, int depth, int dropped, Model &lod) const;
+    // A box the leaf color around all of the boxes.
+    BoxInstance leafBlob(const BoxInstance *boxes, size_t count) const;
+    /**
+     * Writes the boxes of the whole tree into out, in pre-order: the trunk, then all of the
+     * left subtree, then all of the right. The top parallelLevels levels are placed here, and
+     * each subtree under them on the shared TaskPool.
+     */
+    void placeTree(const Level *levels, BoxInstance *out) const;
+    /**
+     * Places the first placedLevels levels of a subtree depth levels deep, whose trunk is at 0
+     * in nodes: writes their boxes into out, and the branches of the level after them into
+     * nodes.
+     */
+    void placeLevels(const Level *levels, int depth, int placedLevels, LevelOrder nodes,
+                     BoxInstance *out) const;
+    // Works out the left and right children of count branches of a level, where rightSlot is
+    // how far after a branch's box its right child's box goes.
+    static void placeChildren(const Level &level, LevelOrder from, LevelOrder left,
+                              LevelOrder right, size_t count, uint32_t rightSlot);
 };
 }
 
@@ -0,0 +1,75 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PARAMWORLD_SSE 1
+#include <emmintrin.h>
+#else
+#include <cmath>
+#endif
+
+namespace ParamWorld
+{
+namespace Simd
+{
+/**
+ * Four floats that are worked on together: an SSE register where the compiler targets SSE2
+ * (every x86-64 build), and a plain array that the same code loops over everywhere else.
+ */
+struct Float4 {
+#ifdef PARAMWORLD_SSE
+    __m128 v;
+
+    static Float4 load(const float *p) { return {_mm_loadu_ps(p)}; }
+    static Float4 broadcast(float x) { return {_mm_set1_ps(x)}; }
+    void store(float *p) const { _mm_storeu_ps(p, v); }
+#else
+    float v[4];
+
+    static Float4 load(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+    static Float4 broadcast(float x) { return {{x, x, x, x}}; }
+    void store(float *p) const
+    {
+        for (int i = 0; i < 4; i++) {
+            p[i] = v[i];
+        }
+    }
+#endif
+};
+
+#ifdef PARAMWORLD_SSE
+inline Float4 operator+(Float4 a, Float4 b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Float4 operator-(Float4 a, Float4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline Float4 operator*(Float4 a, Float4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline Float4 operator/(Float4 a, Float4 b) { return {_mm_div_ps(a.v, b.v)}; }
+inline Float4 sqrt(Float4 a) { return {_mm_sqrt_ps(a.v)}; }
+// Each lane is a where test is above zero, and b where it isn't.
+inline Float4 selectPositive(Float4 test, Float4 a, Float4 b)
+{
+    __m128 mask = _mm_cmpgt_ps(test.v, _mm_setzero_ps());
+    return {_mm_or_ps(_mm_and_ps(mask, a.v), _mm_andnot_ps(mask, b.v))};
+}
+#else
+#define PARAMWORLD_SIMD_LANEWISE(expr)   \
+    Float4 r;                            \
+    for (int i = 0; i < 4; i++) {        \
+        r.v[i] = (expr);                 \
+    }                                    \
+    return r;
+
+inline Float4 operator+(Float4 a, Float4 b) { PARAMWORLD_SIMD_LANEWISE(a.v[i] + b.v[i]) }
+inline Float4 operator-(Float4 a, Float4 b) { PARAMWORLD_SIMD_LANEWISE(a.v[i] - b.v[i]) }
+inline Float4 operator*(Float4 a, Float4 b) { PARAMWORLD_SIMD_LANEWISE(a.v[i] * b.v[i]) }
+inline Float4 operator/(Float4 a, Float4 b) { PARAMWORLD_SIMD_LANEWISE(a.v[i] / b.v[i]) }
+inline Float4 sqrt(Float4 a) { PARAMWORLD_SIMD_LANEWISE(std::sqrt(a.v[i])) }
+inline Float4 selectPositive(Float4 test, Float4 a, Float4 b)
+{
+    PARAMWORLD_SIMD_LANEWISE(test.v[i] > 0.0f ? a.v[i] : b.v[i])
+}
+
+#undef PARAMWORLD_SIMD_LANEWISE
+#endif
+}
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef SPATIALGRID_HPP
+#define SPATIALGRID_HPP
+
+#include <unordered_map>
+#include <vector>
+#include "Square.hpp"
+#include "headers.hpp"
+
+namespace ParamWorld
+{
+/**
+ * A uniform grid of items over the same Squares that the world is explored in, so that
+ * looking for items near a point only touches the squares around it.
+ */
+template <typename T>
+class SpatialGrid
+{
+   public:
+    void insert(glm::vec3 position, T item);
+
+    // Removes one item equal to item that was inserted at position. Returns false if none was.
+    bool remove(glm::vec3 position, const T &item);
+
+    // Calls visit(item) on every item that is within radius of center.
+    template <typename Visitor>
+    void forEachNear(glm::vec3 center, float radius, Visitor visit) const;
+
+    size_t size() const { return _size; }
+
+   private:
+    struct Entry {
+        glm::vec3 position;
+        T item;
+    };
+    std::unordered_map<Square, std::vector<Entry>> _cells;
+    size_t _size = 0;
+};
+
+template <typename T>
+void SpatialGrid<T>::insert(glm::vec3 position, T item)
+{
+    _cells[Square::containing(position)].push_back({position, item});
+    _size++;
+}
+
+template <typename T>
+bool SpatialGrid<T>::remove(glm::vec3 position, const T &item)
+{
+    auto cell = _cells.find(Square::containing(position));
+    if (cell == _cells.end()) {
+        return false;
+    }
+    std::vector<Entry> &entries = cell->second;
+    for (auto it = entries.begin(); it < entries.end(); it++) {
+        if (it->item == item) {
+            *it = entries.back();
+            entries.pop_back();
+            if (entries.empty()) {
+                _cells.erase(cell);
+            }
+            _size--;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+template <typename Visitor>
+void SpatialGrid<T>::forEachNear(glm::vec3 center, float radius, Visitor visit) const
+{
+    Square low = Square::containing(center - glm::vec3(radius, 0, radius));
+    Square high = Square::containing(center + glm::vec3(radius, 0, radius));
+    for (int x = low.x; x <= high.x; x++) {
+        for (int z = low.z; z <= high.z; z++) {
+            auto cell = _cells.find(Square(x, z));
+            if (cell == _cells.end()) {
+                continue;
+            }
+            for (const Entry &entry : cell->second) {
+                if (glm::length(entry.position - center) < radius) {
+                    visit(entry.item);
+                }
+            }
+        }
+    }
+}
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef SQUARE_HPP
+#define SQUARE_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include "headers.hpp"
+
+namespace ParamWorld
+{
+/**
+ * One cell of the grid that the world is explored and generated in.
+ */
+struct Square {
+    // Width of a square along x and z.
+    static constexpr float Size = 5.0f;
+
+    int x;
+    int z;
+
+    Square(int xx, int zz) : x(xx), z(zz) {}
+    bool operator==(const Square s) const { return s.x == x && s.z == z; }
+
+    // The square of the world grid that position falls in.
+    static Square containing(glm::vec3 position)
+    {
+        return Square((int)std::floor(position[0] / Size), (int)std::floor(position[2] / Size));
+    }
+};
+}
+
+namespace std
+{
+template <>
+struct hash<ParamWorld::Square> {
+    size_t operator()(const ParamWorld::Square &sq) const
+    {
+        // Both coordinates in one 64 bit key, so that (a, b) and (b, a) don't collide.
+        return std::hash<uint64_t>()((uint64_t(uint32_t(sq.x)) << 32) | uint32_t(sq.z));
+    }
+};
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef TASKPOOL_HPP
+#define TASKPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ParamWorld
+{
+/**
+ * A work-stealing thread pool for splitting one big job (like building a tree) across cores.
+ *
+ * Each worker has its own queue. Workers take their newest task first (it shares the most
+ * with what they just did) and, when out of work, steal the oldest task from another worker.
+ * Threads that wait on a group run tasks while they wait, so tasks can submit and wait on
+ * more tasks without deadlocking.
+ */
+class TaskPool
+{
+   public:
+    // A set of tasks that can be waited on together.
+    class Group
+    {
+       public:
+        Group() : _pending(0) {}
+
+       private:
+        friend class TaskPool;
+        std::atomic<int> _pending;
+    };
+
+    // Zero workers picks one per core.
+    explicit TaskPool(unsigned workerCount = 0);
+    // Waits for the workers to empty their queues, then joins them.
+    ~TaskPool();
+
+    void submit(Group &group, std::function<void()> task);
+
+    // Runs tasks until every task submitted to group has finished.
+    void wait(Group &group);
+
+    // The pool shared by everything in the game.
+    static TaskPool &shared();
+
+   private:
+    struct Task {
+        std::function<void()> run;
+        Group *group;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // Runs one task, from queue home if it has any or stolen from another queue.
+    // Returns false if there was nothing to run.
+    bool runOne(size_t home);
+    void work(size_t index);
+
+    // One queue per worker, plus one for threads outside the pool.
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _workers;
+    std::atomic<int> _queued;
+    std::atomic<bool> _stopping;
+    std::mutex _sleepMutex;
+    // Workers sleep on _wake until there are tasks. Threads in wait() sleep on _finished
+    // until a group is done or there are tasks; _waiters counts them.
+    std::condition_variable _wake, _finished;
+    int _waiters;
+};
+}
+
+#endif
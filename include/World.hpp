@@ -5,37 +5,26 @@
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/transform.hpp>
-#include <unordered_set>
+#include <deque>
+#include <limits>
+#include <unordered_map>
 #include <vector>
 #include "headers.hpp"
 
+#include "AnimationTable.hpp"
+#include "ChunkBatch.hpp"
+#include "ChunkLifetimes.hpp"
+#include "Frustum.hpp"
+#include "GenerationQueue.hpp"
+#include "ImpostorAtlas.hpp"
+#include "ObjectStore.hpp"
 #include "Params/SceneParams.h"
 #include "SceneObjects/RockObject.hpp"
 #include "SceneObjects/SceneObject.hpp"
 #include "SceneObjects/SkyObject.hpp"
 #include "SceneObjects/TreeObject.hpp"
-
-namespace ParamWorld
-{
-struct Square {
-    int x;
-    int z;
-
-    Square(int xx, int zz) : x(xx), z(zz) {}
-    bool operator==(const Square s) const { return s.x == x && s.z == z; }
-};
-}
-
-namespace std
-{
-template <>
-struct hash<ParamWorld::Square> {
-    size_t operator()(const ParamWorld::Square &sq) const
-    {
-        return std::hash<int>()(sq.x) ^ std::hash<int>()(sq.z);
-    }
-};
-}
+#include "SpatialGrid.hpp"
+#include "Square.hpp"
 
 namespace ParamWorld
 {
@@ -44,25 +33,81 @@ class World
    public:
     void Render(glm::mat4 Perspective, glm::vec3 position, glm::vec3 direction, glm::vec3 up);
     void updateExploredSquares(GLFWwindow *window, glm::vec3 position, float horizontalAngle);
-    World(float worldExtent, GLuint matID);
+    /**
+     * @param programID the shader for plain triangle models.
+     * @param instancedProgramID the shader for instanced boxes (InstancedVertexShader.glsl).
+     * @param impostorProgramID the shader for impostors (ImpostorVertexShader.glsl).
+     * @param seed everything random in the world comes from this, so walking the same way
+     *        through a world with the same seed sees the same things.
+     */
+    World(float worldExtent, GLuint programID, GLuint instancedProgramID,
+          GLuint impostorProgramID, uint64_t seed);
+
+    // Caps how many bytes of new models are sent to the GPU each frame.
+    void setUploadBudget(size_t bytesPerFrame) { uploadBudget = bytesPerFrame; }
+    // Chunks further away than this draw their trees as impostors. Infinity turns them off
+    // for trees that are finished after the change.
+    void setImpostorDistance(float distance) { impostorDistance = distance; }
+    // Squares further away than this are freed, and built again if the player comes back.
+    void setEvictionRadius(float radius) { lifetimes.setEvictionRadius(radius); }
 
    private:
+    // Queues up new objects to be generated around (x, z).
     void AddMoreThings(float x, float z, float horizontalAngle);
+    // Queues up uploads for all objects that finished generating since the last frame.
+    void AddGeneratedThings();
+    // Streams queued objects to the GPU within the budget, and starts drawing finished ones.
+    void UploadPending();
+    // Streams what was baked into chunks since their last upload, out of what is left of
+    // this frame's budget.
+    void UploadChunks();
+    // Frees the squares that are far from position, and rebuilds the ones that are near again.
+    void EvictFarSquares(glm::vec3 position);
+    // Frees the impostors that no chunk draws any more.
+    void ReleaseUnusedImpostors();
+    // Level of detail to draw something at, given how far it is from the camera.
+    int lodFor(float distance) const;
 
+    uint64_t worldSeed;
     // The parameters that generate the new parts of the world.
     SceneParams sceneParams;
+    // Builds new objects off of the render thread.
+    GenerationQueue generator;
     // All objects (RockObjects, TreeObjects, etc.) in the world.
-    std::vector<SceneObject> allObjects;
-    // Objects that can still move the param means.
-    std::vector<SceneObject> relevantObjects;
+    ObjectStore allObjects;
+    // Objects whose models are still being uploaded, oldest first. Not drawn yet.
+    std::deque<ObjectHandle> uploadQueue;
+    // Squares whose chunks have geometry that isn't uploaded yet, oldest first.
+    std::deque<Square> chunkUploads;
+    size_t uploadBudget = 256 * 1024;
+    // What is left of uploadBudget this frame.
+    size_t budgetLeft = 0;
+    // Objects that are still growing, and so are drawn on their own.
+    AnimationTable growingObjects;
+    // Objects that are done growing, baked together by the grid square they're in.
+    std::unordered_map<Square, ChunkBatch> chunks;
+    // Which squares are kept in memory, and how to build the others again.
+    ChunkLifetimes lifetimes;
+    Square currentSquare = Square(0, 0);
+    // Objects that can still move the param means, by location.
+    SpatialGrid<ObjectHandle> relevantObjects;
     // Model representing the floor and sky.
     Ground g;
     SkyObject s;
+    // Pictures of finished trees, for drawing them far away.
+    ImpostorAtlas atlas;
+    // For each index in the atlas: the mesh it's a picture of, and how many chunks draw it.
+    struct ImpostorSlot {
+        std::weak_ptr<Mesh> mesh;
+        int chunkUses = 0;
+        bool used = false;
+    };
+    std::vector<ImpostorSlot> impostorSlots;
+    float impostorDistance = 120.0f;
 
-    // The set of all grid spaces that have been explored in this world. Kept at TODO intervals.
-    std::unordered_set<Square> exploredSquares;
-
-    GLuint MatrixID;
+    GLuint ProgramID, MatrixID;
+    GLuint InstancedProgramID, InstancedMatrixID;
+    GLuint ImpostorProgramID;
 
     double lastAdded = glfwGetTime();
 
@@ -0,0 +1,76 @@
+#include "AnimationTable.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace ParamWorld;
+
+void AnimationTable::add(ObjectHandle handle, const Function &growth, glm::vec3 rootPosition)
+{
+    _handles.push_back(handle);
+    _kinds.push_back(growth.kind);
+    _offsets.push_back(growth.offset);
+    _rates.push_back(growth.rate);
+    _rootX.push_back(rootPosition[0]);
+    _rootY.push_back(rootPosition[1]);
+    _rootZ.push_back(rootPosition[2]);
+    // Nothing to draw until the first update().
+    _modelMatrices.push_back(glm::mat4(0.0f));
+}
+
+void AnimationTable::update(double time, std::vector<ObjectHandle> &finished)
+{
+    const size_t count = _handles.size();
+    _scales.resize(count);
+    _saturated.resize(count);
+
+    // Every kind is worked out for every animation and the right one picked, so the loop has
+    // no branches and the compiler can vectorize it.
+    const double ends[] = {Function::saturationPoint(Function::Constant),
+                           Function::saturationPoint(Function::Linear),
+                           Function::saturationPoint(Function::Logistic)};
+    for (size_t i = 0; i < count; i++) {
+        Function::Kind kind = _kinds[i];
+        double u = _rates[i] * (time - _offsets[i]);
+        double linear = std::min(u, 1.0);
+        double logistic = 1 / (1 + std::exp(-u));
+        double scale = (kind == Function::Linear) ? linear : logistic;
+        _scales[i] = (kind == Function::Constant) ? 1.0 : scale;
+        _saturated[i] = u >= ends[kind];
+    }
+
+    // translate(root) * scale(s), written out.
+    for (size_t i = 0; i < count; i++) {
+        float s = _scales[i];
+        _modelMatrices[i] = glm::mat4(glm::vec4(s, 0, 0, 0), glm::vec4(0, s, 0, 0),
+                                      glm::vec4(0, 0, s, 0),
+                                      glm::vec4(_rootX[i], _rootY[i], _rootZ[i], 1));
+    }
+
+    for (size_t i = count; i-- > 0;) {
+        if (_saturated[i]) {
+            finished.push_back(_handles[i]);
+            erase(i);
+        }
+    }
+}
+
+void AnimationTable::erase(size_t i)
+{
+    size_t last = _handles.size() - 1;
+    _handles[i] = _handles[last];
+    _kinds[i] = _kinds[last];
+    _offsets[i] = _offsets[last];
+    _rates[i] = _rates[last];
+    _rootX[i] = _rootX[last];
+    _rootY[i] = _rootY[last];
+    _rootZ[i] = _rootZ[last];
+    _modelMatrices[i] = _modelMatrices[last];
+    _handles.pop_back();
+    _kinds.pop_back();
+    _offsets.pop_back();
+    _rates.pop_back();
+    _rootX.pop_back();
+    _rootY.pop_back();
+    _rootZ.pop_back();
+    _modelMatrices.pop_back();
+}
@@ -0,0 +1,54 @@
+#include "ChunkBatch.hpp"
+
+using namespace ParamWorld;
+
+void ChunkBatch::Add(const SceneObject &object)
+{
+    Add(object, ImpostorInstance{glm::vec3(0, 0, 0), 0.0f, -1});
+}
+
+void ChunkBatch::Add(const SceneObject &object, const ImpostorInstance &impostor)
+{
+    if (_empty) {
+        // Measure positions from the first object in the chunk, so they stay small enough
+        // to be stored as half floats.
+        for (Model &model : _models) {
+            model.setVertexFormat(VertexFormat::Compact, object.rootPosition);
+        }
+        _empty = false;
+    }
+    for (int lod = 0; lod < LodCount; lod++) {
+        _models[lod].Append(object.getModel(lod), glm::translate(object.rootPosition));
+    }
+    if (impostor.index >= 0) {
+        ImpostorInstance placed = impostor;
+        placed.center += object.rootPosition;
+        _impostors.add(placed);
+    } else {
+        _models[ImpostorLod].Append(object.getModel(LodCount - 1),
+                                    glm::translate(object.rootPosition));
+    }
+}
+
+size_t ChunkBatch::uploadSome(size_t maxBytes)
+{
+    size_t sent = 0;
+    for (Model &model : _models) {
+        sent += model.uploadAppended(maxBytes - sent);
+    }
+    return sent;
+}
+
+bool ChunkBatch::uploaded() const
+{
+    for (const Model &model : _models) {
+        if (!model.uploaded()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ChunkBatch::Draw(int lod) { _models[lod].drawBuffer(); }
+
+void ChunkBatch::DrawInstances(int lod) { _models[lod].drawInstances(); }
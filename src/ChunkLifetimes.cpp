@@ -0,0 +1,125 @@
+#include "ChunkLifetimes.hpp"
+#include <cmath>
+
+using namespace ParamWorld;
+
+float ChunkLifetimes::distance(Square square, glm::vec3 position)
+{
+    glm::vec2 center((square.x + 0.5f) * Square::Size, (square.z + 0.5f) * Square::Size);
+    return glm::length(center - glm::vec2(position[0], position[2]));
+}
+
+ChunkLifetimes::Contents &ChunkLifetimes::contents(Square square)
+{
+    auto inserted = _squares.emplace(square, Contents());
+    if (inserted.second) {
+        _resident.insert(square);
+    }
+    return inserted.first->second;
+}
+
+bool ChunkLifetimes::explore(Square square)
+{
+    Contents &explored = contents(square);
+    if (explored.explored) {
+        return false;
+    }
+    explored.explored = true;
+    return true;
+}
+
+void ChunkLifetimes::addJob(GenerationJob &job)
+{
+    Contents &square = contents(Square::containing(job.rootPosition));
+    job.generation = square.generation;
+    job.index = square.jobs.size();
+    square.jobs.push_back(job);
+}
+
+bool ChunkLifetimes::addObject(const GenerationJob &job, ObjectHandle handle)
+{
+    auto found = _squares.find(Square::containing(job.rootPosition));
+    if (found == _squares.end()) {
+        return false;
+    }
+    Contents &contents = found->second;
+    if (!contents.resident || job.generation != contents.generation) {
+        return false;
+    }
+    contents.objects.push_back(Built{handle, job.index});
+    return true;
+}
+
+const GenerationJob *ChunkLifetimes::jobFor(glm::vec3 rootPosition, ObjectHandle handle) const
+{
+    auto found = _squares.find(Square::containing(rootPosition));
+    if (found == _squares.end()) {
+        return nullptr;
+    }
+    for (const Built &built : found->second.objects) {
+        if (built.handle == handle) {
+            return &found->second.jobs[built.job];
+        }
+    }
+    return nullptr;
+}
+
+void ChunkLifetimes::learn(glm::vec3 rootPosition, ObjectHandle handle)
+{
+    if (const GenerationJob *job = jobFor(rootPosition, handle)) {
+        const_cast<GenerationJob *>(job)->learned = true;
+    }
+}
+
+bool ChunkLifetimes::learned(glm::vec3 rootPosition, ObjectHandle handle) const
+{
+    const GenerationJob *job = jobFor(rootPosition, handle);
+    return job != nullptr && job->learned;
+}
+
+void ChunkLifetimes::update(glm::vec3 position, std::vector<Square> &evictedSquares,
+                            std::vector<ObjectHandle> &evictedObjects,
+                            std::vector<GenerationJob> &jobs)
+{
+    for (auto it = _resident.begin(); it != _resident.end();) {
+        if (distance(*it, position) <= _evictionRadius) {
+            ++it;
+            continue;
+        }
+        Contents &contents = _squares[*it];
+        evictedSquares.push_back(*it);
+        for (const Built &built : contents.objects) {
+            evictedObjects.push_back(built.handle);
+        }
+        contents.objects.clear();
+        contents.objects.shrink_to_fit();
+        contents.resident = false;
+        contents.generation++;
+        it = _resident.erase(it);
+    }
+
+    if (_resident.size() == _squares.size()) {
+        return;
+    }
+    // Evicted squares that are close again can only be among those around position.
+    float returnRadius = _evictionRadius * _returnFraction;
+    Square middle = Square::containing(position);
+    int reach = (int)std::ceil(returnRadius / Square::Size) + 1;
+    for (int x = middle.x - reach; x <= middle.x + reach; x++) {
+        for (int z = middle.z - reach; z <= middle.z + reach; z++) {
+            auto found = _squares.find(Square(x, z));
+            if (found == _squares.end() || found->second.resident ||
+                distance(found->first, position) >= returnRadius) {
+                continue;
+            }
+            Contents &contents = found->second;
+            for (GenerationJob job : contents.jobs) {
+                job.generation = contents.generation;
+                job.fullyGrown = true;
+                jobs.push_back(job);
+            }
+            contents.resident = true;
+            _resident.insert(found->first);
+        }
+    }
+}
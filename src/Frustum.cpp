@@ -0,0 +1,47 @@
+#include "Frustum.hpp"
+
+using namespace ParamWorld;
+
+Frustum::Frustum(const glm::mat4 &viewProjection)
+{
+    // Gribb & Hartmann: each plane is the last row plus or minus one of the other rows.
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i],
+                            viewProjection[3][i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        _planes[2 * i] = rows[3] + rows[i];
+        _planes[2 * i + 1] = rows[3] - rows[i];
+    }
+    for (auto &plane : _planes) {
+        plane = plane / glm::length(glm::vec3(plane));
+    }
+}
+
+bool Frustum::intersects(const Bounds &box) const
+{
+    if (box.empty()) {
+        return false;
+    }
+    for (const auto &plane : _planes) {
+        // The corner of the box furthest along the plane's normal.
+        glm::vec3 corner(plane[0] > 0 ? box.max[0] : box.min[0],
+                         plane[1] > 0 ? box.max[1] : box.min[1],
+                         plane[2] > 0 ? box.max[2] : box.min[2]);
+        if (glm::dot(glm::vec3(plane), corner) + plane[3] < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::intersects(glm::vec3 center, float radius) const
+{
+    for (const auto &plane : _planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane[3] < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
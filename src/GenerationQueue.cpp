@@ -0,0 +1,89 @@
+#include "GenerationQueue.hpp"
+#include "SceneObjects/RockObject.hpp"
+#include "SceneObjects/TreeObject.hpp"
+
+using namespace ParamWorld;
+
+GenerationQueue::GenerationQueue(unsigned workerCount)
+{
+    if (workerCount == 0) {
+        unsigned cores = std::thread::hardware_concurrency();
+        workerCount = (cores > 2) ? cores - 1 : 1;
+    }
+    for (unsigned i = 0; i < workerCount; i++) {
+        _workers.emplace_back(&GenerationQueue::work, this);
+    }
+}
+
+GenerationQueue::~GenerationQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    for (auto &worker : _workers) {
+        worker.join();
+    }
+}
+
+void GenerationQueue::push(GenerationJob job)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _jobs.push_back(job);
+    }
+    _wake.notify_one();
+}
+
+void GenerationQueue::collect(std::vector<GeneratedObject> &done)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto &finished : _finished) {
+        done.push_back(std::move(finished));
+    }
+    _finished.clear();
+}
+
+size_t GenerationQueue::pending() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _jobs.size() + _inProgress;
+}
+
+std::unique_ptr<SceneObject> GenerationQueue::generate(const GenerationJob &job,
+                                                       MeshCache *cache)
+{
+    std::unique_ptr<SceneObject> object;
+    if (job.kind == GenerationJob::Tree) {
+        object.reset(new TreeObject(job.rootPosition, job.params, cache));
+    } else {
+        object.reset(new RockObject(job.rootPosition, glm::vec2(1.0f, 0), glm::vec2(-0.5f, -.5f),
+                                    glm::vec2(-0.5f, 0.5f), job.params, job.seed));
+    }
+    if (job.fullyGrown) {
+        object->finishGrowing();
+    }
+    return object;
+}
+
+void GenerationQueue::work()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _wake.wait(lock, [this] { return _stopping || !_jobs.empty(); });
+        if (_stopping) {
+            return;
+        }
+        GenerationJob job = _jobs.front();
+        _jobs.pop_front();
+        _inProgress++;
+
+        lock.unlock();
+        std::unique_ptr<SceneObject> object = generate(job, &_meshes);
+        lock.lock();
+
+        _finished.push_back(GeneratedObject{job, std::move(object)});
+        _inProgress--;
+    }
+}
@@ -0,0 +1,191 @@
+#include "ImpostorAtlas.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <utility>
+
+#define MATH_FLOAT_PI 3.1415926f
+
+using namespace ParamWorld;
+
+ImpostorAtlas::ImpostorAtlas(GLuint instancedProgramID, int capacity, int tileSize)
+    : _instancedProgram(instancedProgramID),
+      _instancedMatrixID(glGetUniformLocation(instancedProgramID, "MVP")),
+      _tileSize(tileSize)
+{
+    // The smallest square that holds every picture, within what the GL can make.
+    _tilesPerSide = (int)std::ceil(std::sqrt(double(capacity) * Views));
+    GLint maxSize;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if (_tilesPerSide * tileSize > maxSize) {
+        _tilesPerSide = maxSize / tileSize;
+        std::cerr << "Impostor atlas: only room for " << _tilesPerSide * _tilesPerSide / Views
+                  << " of " << capacity << " impostors." << std::endl;
+    }
+    int side = tileSize * _tilesPerSide;
+    glGenTextures(1, &_texture);
+    glBindTexture(GL_TEXTURE_2D, _texture);
+    for (int level = 0; level <= MaxMipLevel; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, side >> level, side >> level, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, MaxMipLevel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenRenderbuffers(1, &_depthbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, _depthbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, side, side);
+
+    GLint previous;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    glGenFramebuffers(1, &_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _texture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depthbuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
+        _capacity = std::min(capacity, _tilesPerSide * _tilesPerSide / Views);
+    } else {
+        std::cerr << "Impostor atlas: framebuffer isn't complete, drawing trees in full."
+                  << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, previous);
+}
+
+ImpostorAtlas::~ImpostorAtlas()
+{
+    glDeleteFramebuffers(1, &_framebuffer);
+    glDeleteRenderbuffers(1, &_depthbuffer);
+    glDeleteTextures(1, &_texture);
+}
+
+ImpostorInstance ImpostorAtlas::add(const Model &model)
+{
+    Bounds bounds = model.bounds();
+    ImpostorInstance impostor = {bounds.center(), bounds.radius(), -1};
+    if ((_free.empty() && _count == _capacity) || bounds.empty()) {
+        return impostor;
+    }
+    if (_free.empty()) {
+        impostor.index = _count++;
+    } else {
+        impostor.index = _free.back();
+        _free.pop_back();
+    }
+
+    GLint previousFramebuffer, previousProgram, viewport[4];
+    GLfloat clearColor[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glUseProgram(_instancedProgram);
+    // Only clear the tile being drawn, not the rest of the atlas.
+    glEnable(GL_SCISSOR_TEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    float r = impostor.radius;
+    glm::mat4 projection = glm::ortho(-r, r, -r, r, 0.0f, 2.0f * r);
+    for (int view = 0; view < Views; view++) {
+        int tile = impostor.index * Views + view;
+        int x = (tile % _tilesPerSide) * _tileSize;
+        int y = (tile / _tilesPerSide) * _tileSize;
+        glScissor(x, y, _tileSize, _tileSize);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glViewport(x + Padding, y + Padding, _tileSize - 2 * Padding, _tileSize - 2 * Padding);
+
+        // Looking at the center from the side, around the y axis starting from +z.
+        float angle = view * 2.0f * MATH_FLOAT_PI / Views;
+        glm::vec3 from = impostor.center + glm::vec3(std::sin(angle), 0, std::cos(angle)) * r;
+        glm::mat4 mvp = projection * glm::lookAt(from, impostor.center, glm::vec3(0, 1, 0));
+        glUniformMatrix4fv(_instancedMatrixID, 1, GL_FALSE, &mvp[0][0]);
+        model.drawInstances();
+    }
+
+    glBindTexture(GL_TEXTURE_2D, _texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glUseProgram(previousProgram);
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    return impostor;
+}
+
+void ImpostorAtlas::bind(GLuint impostorProgramID, const glm::mat4 &viewProjection,
+                         glm::vec3 cameraPosition) const
+{
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, _texture);
+    glUniform1i(glGetUniformLocation(impostorProgramID, "Atlas"), 0);
+    glUniformMatrix4fv(glGetUniformLocation(impostorProgramID, "VP"), 1, GL_FALSE,
+                       &viewProjection[0][0]);
+    glUniform3f(glGetUniformLocation(impostorProgramID, "CameraPosition"), cameraPosition.x,
+                cameraPosition.y, cameraPosition.z);
+    glUniform1i(glGetUniformLocation(impostorProgramID, "Views"), Views);
+    glUniform1i(glGetUniformLocation(impostorProgramID, "TilesPerSide"), _tilesPerSide);
+    glUniform1f(glGetUniformLocation(impostorProgramID, "TileInset"), float(Padding) / _tileSize);
+}
+
+ImpostorBatch::ImpostorBatch(ImpostorBatch &&other)
+    : _impostors(std::move(other._impostors)),
+      _buffer(other._buffer),
+      _vertexArray(other._vertexArray),
+      _dirty(other._dirty)
+{
+    other._buffer = other._vertexArray = 0;
+}
+
+ImpostorBatch::~ImpostorBatch()
+{
+    if (_buffer != 0) {
+        glDeleteBuffers(1, &_buffer);
+        glDeleteVertexArrays(1, &_vertexArray);
+    }
+}
+
+void ImpostorBatch::add(const ImpostorInstance &impostor)
+{
+    _impostors.push_back(impostor);
+    _dirty = true;
+}
+
+void ImpostorBatch::draw()
+{
+    if (_impostors.empty()) {
+        return;
+    }
+    if (_buffer == 0) {
+        glGenBuffers(1, &_buffer);
+        glGenVertexArrays(1, &_vertexArray);
+        glBindVertexArray(_vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+        // The quad's corners come from gl_VertexID, so there are only per instance attributes.
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance),
+                              reinterpret_cast<void *>(offsetof(ImpostorInstance, center)));
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance),
+                              reinterpret_cast<void *>(offsetof(ImpostorInstance, radius)));
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 1, GL_INT, sizeof(ImpostorInstance),
+                               reinterpret_cast<void *>(offsetof(ImpostorInstance, index)));
+        for (GLuint attrib = 3; attrib <= 5; attrib++) {
+            glVertexAttribDivisor(attrib, 1);
+        }
+    }
+    glBindVertexArray(_vertexArray);
+    if (_dirty) {
+        glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+        glBufferData(GL_ARRAY_BUFFER, _impostors.size() * sizeof(ImpostorInstance),
+                     _impostors.data(), GL_STATIC_DRAW);
+        _dirty = false;
+    }
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, _impostors.size());
+}
@@ -0,0 +1,24 @@
+#version 330 core
+
+in vec2 atlasCoord;
+out vec3 color;
+
+uniform sampler2D Atlas;
+
+const float MipAlphaScale = 0.4;
+
+// Runs on every fragment; the empty parts of each picture are see through.
+void main() {
+  vec4 texel = texture(Atlas, atlasCoord);
+  // Coarser mip levels average thin branches with the empty space around them, which would
+  // fade them out of the alpha test. Raising alpha with the level keeps them as thick.
+  vec2 texels = atlasCoord * vec2(textureSize(Atlas, 0));
+  vec2 dx = dFdx(texels), dy = dFdy(texels);
+  float level = max(0.0, 0.5 * log2(max(dot(dx, dx), dot(dy, dy))));
+  if (texel.a * (1.0 + level * MipAlphaScale) < 0.5) {
+    discard;
+  }
+  // Pictures are drawn over transparent black, so mip levels average the colors of a
+  // picture's edges with black in proportion to alpha. Dividing by it takes that back out.
+  color = texel.rgb / texel.a;
+}
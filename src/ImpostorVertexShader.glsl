@@ -0,0 +1,40 @@
+#version 330 core
+// vertex shader for far away trees drawn as impostors (see ImpostorAtlas.hpp).
+// Each instance is one quad that turns to face the camera around the y axis, and shows
+//   the picture in the atlas that was taken from the closest angle to where the camera is.
+// The quad's 4 corners come from gl_VertexID, drawn as a triangle strip.
+layout(location = 3) in vec3 instanceCenter;
+layout(location = 4) in float instanceRadius;
+layout(location = 5) in int instanceIndex;
+
+out vec2 atlasCoord;
+
+uniform mat4 VP;
+uniform vec3 CameraPosition;
+// Pictures per impostor, and pictures along each side of the atlas.
+uniform int Views;
+uniform int TilesPerSide;
+// The empty border around each picture, as a fraction of its tile.
+uniform float TileInset;
+
+const float PI = 3.1415926;
+
+void main() {
+  vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+
+  vec3 toCamera = CameraPosition - instanceCenter;
+  toCamera.y = 0.0;
+  toCamera = (length(toCamera) > 0.0001) ? normalize(toCamera) : vec3(0, 0, 1);
+  // Pictures were taken every 2 PI / Views around the y axis, starting from +z.
+  float turns = atan(toCamera.x, toCamera.z) / (2.0 * PI);
+  int view = int(mod(round(turns * Views), float(Views)));
+
+  vec3 up = vec3(0, 1, 0);
+  vec3 right = cross(-toCamera, up);
+  vec3 position = instanceCenter + (right * (corner.x * 2.0 - 1.0) + up * (corner.y * 2.0 - 1.0)) * instanceRadius;
+  gl_Position = VP * vec4(position, 1);
+
+  int tile = instanceIndex * Views + view;
+  vec2 tileCorner = vec2(tile % TilesPerSide, tile / TilesPerSide);
+  atlasCoord = (tileCorner + TileInset + corner * (1.0 - 2.0 * TileInset)) / float(TilesPerSide);
+}
@@ -0,0 +1,27 @@
+#version 330 core
+// vertex shader for boxes drawn with instancing.
+// Locations 0 and 2 are the shared unit cube, like in SimpleVertexShader.glsl.
+// Locations 3 to 6 advance once per instance (see glVertexAttribDivisor), and
+//   place, size, turn and color each copy of the cube.
+layout(location = 0) in vec3 vertexPosition_modelspace;
+layout(location = 3) in vec3 instanceCenter;
+layout(location = 4) in vec3 instanceSize;
+layout(location = 5) in vec4 instanceRotation;
+layout(location = 6) in vec3 instanceColor;
+
+out vec3 fragmentColor;
+// Values that stay constant for the whole mesh.
+uniform mat4 MVP;
+
+// Rotates v by the unit quaternion q (stored as x, y, z, w).
+vec3 rotate(vec4 q, vec3 v) {
+  return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// This is called for each vertex of each instance.
+void main() {
+  vec3 position = instanceCenter + rotate(instanceRotation, vertexPosition_modelspace * instanceSize);
+  gl_Position = MVP * vec4(position, 1);
+
+  fragmentColor = instanceColor;
+}
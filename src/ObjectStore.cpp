@@ -0,0 +1,38 @@
+#include "ObjectStore.hpp"
+
+using namespace ParamWorld;
+
+ObjectHandle ObjectStore::add(std::unique_ptr<SceneObject> object)
+{
+    uint32_t index;
+    if (_freeSlots.empty()) {
+        index = _slots.size();
+        _slots.emplace_back();
+    } else {
+        index = _freeSlots.back();
+        _freeSlots.pop_back();
+    }
+    _slots[index].object = std::move(object);
+    return {index, _slots[index].generation};
+}
+
+SceneObject *ObjectStore::get(ObjectHandle handle) const
+{
+    if (handle.index >= _slots.size() || _slots[handle.index].generation != handle.generation) {
+        return nullptr;
+    }
+    return _slots[handle.index].object.get();
+}
+
+bool ObjectStore::remove(ObjectHandle handle)
+{
+    if (get(handle) == nullptr) {
+        return false;
+    }
+    Slot &slot = _slots[handle.index];
+    slot.object.reset();
+    // Old handles to this slot won't match anymore.
+    slot.generation++;
+    _freeSlots.push_back(handle.index);
+    return true;
+}
@@ -1,4 +1,5 @@
 #include "Params/SParam.hpp"
+#include "Params/TruncatedNormal.hpp"
 
 using namespace ParamWorld;
 
@@ -10,25 +11,12 @@ float SParam::generateUniform(float randNum)
     return randNum * (max - min) + min;
 }
 
-float SParam::generateGaussian(float mean, float variance,
-                               std::normal_distribution<float> unitNormalDistribution)
+float SParam::generateGaussian(float mean, float variance, Random &random)
 {
-    std::normal_distribution<float> dist(0.0f, 1.0f);
-    float val = 0.0f;
-
-    do {
-        val = unitNormalDistribution(randomGenerator) * (max - min) / 2 * variance + mean;
-    } while (val > max || val < min);
-
-    if (isIntegral) {
-        return round(val);
-    }
-
-    return val;
+    return valid(sampleTruncatedNormal(mean, sigma(variance), min, max, random));
 }
 
 SParam::SParam(bool _isIntegral, float _min, float _max)
-    : isIntegral(_isIntegral), randomGenerator(), min(_min), max(_max)
+    : isIntegral(_isIntegral), min(_min), max(_max)
 {
-    randomGenerator.seed((unsigned int)time(nullptr));
 }
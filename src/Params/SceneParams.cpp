@@ -4,12 +4,12 @@
 
 using namespace ParamWorld;
 
-ParamArray<SP_Count> SceneParams::generate(float deviance)
+ParamArray<SP_Count> SceneParams::generate(float deviance, Random &random)
 {
     ParamArray<SP_Count> newVec;
     for (int i = 0; i < SP_Count; i++) {
         newVec[i] = AllParams[i]->generateGaussian(paramMeans[i], paramVariances[i] * deviance,
-                                                   unitNormalDistribution);
+                                                   random);
     }
     return newVec;
 }
@@ -18,7 +18,7 @@ ParamArray<SP_Count> SceneParams::randomSP()
 {
     ParamArray<SP_Count> newVec;
     for (int i = 0; i < SP_Count; i++) {
-        newVec[i] = AllParams[i]->generateUniform(unitUniformDistribution(randomGenerator));
+        newVec[i] = AllParams[i]->generateUniform(randomGenerator.uniform());
     }
     return newVec;
 }
@@ -90,39 +90,48 @@ void SceneParams::resetVariability()
     learningRate = learningMaximum;
 }
 
-SceneParams::SceneParams() : SceneParams((unsigned int)time(nullptr)) {}
-SceneParams::SceneParams(unsigned int seed)
+const SParam &SceneParams::definition(int param)
 {
-    randomGenerator.seed(((unsigned int)time(nullptr)));
-    // Colors
-    AllParams[SP_Red] = new SParam(false, 0.0f, 1.0f);
-    AllParams[SP_Green] = new SParam(false, 0.0f, 1.0f);
-    AllParams[SP_Blue] = new SParam(false, 0.0f, 1.0f);
-    AllParams[SP_Alpha] = new SParam(false, 0.0f, 1.0f);
-
-    AllParams[SP_Depth] = new SParam(true, 1.0f, 8.0f);
-    AllParams[SP_Width] = new SParam(false, 0.1f, 2.0f);
-    AllParams[SP_Height] = new SParam(false, 0.2f, 20.0f);
-    AllParams[SP_Scale] = new SParam(false, 0.1f, .98f);
-    AllParams[SP_SplitAngle] = new SParam(false, 0.1f, MATH_FLOAT_PI / 4);
-    AllParams[SP_BranchR] = new SParam(false, 0.0f, 1.0f);
-    AllParams[SP_BranchG] = new SParam(false, 0.0f, 1.0f);
-    AllParams[SP_BranchB] = new SParam(false, 0.0f, 1.0f);
-    AllParams[SP_LeafR] = new SParam(false, 0.0f, 1.0f);
-    AllParams[SP_LeafG] = new SParam(false, 0.0f, 1.0f);
-    AllParams[SP_LeafB] = new SParam(false, 0.0f, 1.0f);
-    AllParams[SP_LeafSize] = new SParam(false, 0.5f, 2.0f);
-
-    AllParams[SP_Rock_Depth] = new SParam(true, 2.0f, 5.0f);
-    AllParams[SP_Rock_R] = new SParam(false, 0.0f, 1.0f);
-    AllParams[SP_Rock_G] = new SParam(false, 0.0f, 1.0f);
-    AllParams[SP_Rock_B] = new SParam(false, 0.0f, 1.0f);
-    AllParams[SP_Rock_HeightMult] = new SParam(false, 0.3f, 1.8f);
+    static const std::vector<SParam> definitions = [] {
+        std::vector<SParam> params(SP_Count, SParam(false, 0.0f, 1.0f));
+        // Colors
+        params[SP_Red] = SParam(false, 0.0f, 1.0f);
+        params[SP_Green] = SParam(false, 0.0f, 1.0f);
+        params[SP_Blue] = SParam(false, 0.0f, 1.0f);
+        params[SP_Alpha] = SParam(false, 0.0f, 1.0f);
+
+        params[SP_Depth] = SParam(true, 1.0f, 8.0f);
+        params[SP_Width] = SParam(false, 0.1f, 2.0f);
+        params[SP_Height] = SParam(false, 0.2f, 20.0f);
+        params[SP_Scale] = SParam(false, 0.1f, .98f);
+        params[SP_SplitAngle] = SParam(false, 0.1f, MATH_FLOAT_PI / 4);
+        params[SP_BranchR] = SParam(false, 0.0f, 1.0f);
+        params[SP_BranchG] = SParam(false, 0.0f, 1.0f);
+        params[SP_BranchB] = SParam(false, 0.0f, 1.0f);
+        params[SP_LeafR] = SParam(false, 0.0f, 1.0f);
+        params[SP_LeafG] = SParam(false, 0.0f, 1.0f);
+        params[SP_LeafB] = SParam(false, 0.0f, 1.0f);
+        params[SP_LeafSize] = SParam(false, 0.5f, 2.0f);
+
+        params[SP_Rock_Depth] = SParam(true, 2.0f, 5.0f);
+        params[SP_Rock_R] = SParam(false, 0.0f, 1.0f);
+        params[SP_Rock_G] = SParam(false, 0.0f, 1.0f);
+        params[SP_Rock_B] = SParam(false, 0.0f, 1.0f);
+        params[SP_Rock_HeightMult] = SParam(false, 0.3f, 1.8f);
+        return params;
+    }();
+    return definitions[param];
+}
+
+SceneParams::SceneParams() : SceneParams((uint64_t)time(nullptr)) {}
+SceneParams::SceneParams(uint64_t seed) : randomGenerator(seed)
+{
+    for (int i = 0; i < SP_Count; i++) {
+        AllParams[i] = new SParam(definition(i));
+    }
 
     // Initialize variances to 1
     for (int i = 0; i < SP_Count; i++) {
-        paramMeans[i] = AllParams[i]->generateUniform(
-            static_cast<float>(rand()) /
-            static_cast<float>(RAND_MAX));  // unitUniformDistribution(randomGenerator));
+        paramMeans[i] = AllParams[i]->generateUniform(randomGenerator.uniform());
     }
 }
@@ -0,0 +1,78 @@
+#include "Params/TruncatedNormal.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace ParamWorld;
+
+double ParamWorld::normalCdf(double x) { return 0.5 * std::erfc(-x / std::sqrt(2.0)); }
+
+double ParamWorld::inverseNormalCdf(double p)
+{
+    // Acklam's rational approximation (relative error 1.15e-9), then one step of Halley's
+    // method against normalCdf to get close to double precision.
+    static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02,
+                               -2.759285104469687e+02, 1.383577518672690e+02,
+                               -3.066479806614716e+01, 2.506628277459239e+00};
+    static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02,
+                               -1.556989798598866e+02, 6.680131188771972e+01,
+                               -1.328068155288572e+01};
+    static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01,
+                               -2.400758277161838e+00, -2.549732539343734e+00,
+                               4.374664141464968e+00,  2.938163982698783e+00};
+    static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01,
+                               2.445134137142996e+00, 3.754408661907416e+00};
+    const double lowTail = 0.02425;
+
+    double x;
+    if (p < lowTail) {
+        double q = std::sqrt(-2.0 * std::log(p));
+        x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+            ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+    } else if (p <= 1.0 - lowTail) {
+        double q = p - 0.5, r = q * q;
+        x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+            (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+    } else {
+        double q = std::sqrt(-2.0 * std::log(1.0 - p));
+        x = -(((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+            ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+    }
+    const double sqrtTwoPi = 2.5066282746310002;
+    double u = (normalCdf(x) - p) * sqrtTwoPi * std::exp(x * x / 2.0);
+    // Far enough out that exp() overflows, the approximation is as good as it gets.
+    return std::isfinite(u) ? x - u / (1.0 + x * u / 2.0) : x;
+}
+
+float ParamWorld::sampleTruncatedNormal(float mean, float sigma, float low, float high,
+                                        Random &random)
+{
+    // Drawn first, so every value uses exactly one whatever happens below.
+    float uniform = random.uniform();
+    if (!(sigma > 0.0f)) {
+        return std::min(std::max(mean, low), high);
+    }
+    double alpha = (low - mean) / double(sigma);
+    double beta = (high - mean) / double(sigma);
+    // normalCdf is only accurate in the lower tail, so a range above the mean is flipped below
+    // it, sampled there, and flipped back.
+    bool flip = alpha > 0.0;
+    if (flip) {
+        std::swap(alpha, beta);
+        alpha = -alpha;
+        beta = -beta;
+    }
+    double from = normalCdf(alpha), to = normalCdf(beta);
+    double x;
+    if (to - from > 0.0) {
+        double p = from + (to - from) * uniform;
+        // Rounding can land p on 0, where the inverse is infinite.
+        p = std::max(p, std::nextafter(0.0, 1.0));
+        x = std::min(std::max(inverseNormalCdf(p), alpha), beta);
+    } else {
+        // The range is so far out in the tail that all of it rounds to the same probability;
+        // nearly all of what's left is at the end closest to the mean.
+        x = beta;
+    }
+    float value = mean + float((flip ? -x : x) * sigma);
+    return std::min(std::max(value, low), high);
+}
@@ -0,0 +1,71 @@
+#include "SceneObjects/FaceNormals.hpp"
+#include "Simd.hpp"
+
+using namespace ParamWorld;
+
+namespace
+{
+void setNormal(Vertex *vertices, const GLuint *triangle, glm::vec3 n)
+{
+    GLuint packed = glm::packSnorm3x10_1x2(glm::vec4(n, 0.0f));
+    for (int corner = 0; corner < 3; corner++) {
+        vertices[triangle[corner]].normal = packed;
+    }
+}
+}
+
+void ParamWorld::faceNormalsScalar(Vertex *vertices, const GLuint *indices, size_t triangleCount)
+{
+    for (size_t t = 0; t < triangleCount; t++) {
+        const GLuint *triangle = indices + t * 3;
+        glm::vec3 a = vertices[triangle[0]].position;
+        glm::vec3 n = glm::cross(vertices[triangle[1]].position - a,
+                                 vertices[triangle[2]].position - a);
+        float len = glm::length(n);
+        setNormal(vertices, triangle, (len > 0.0f) ? n / len : glm::vec3(0, 1, 0));
+    }
+}
+
+void ParamWorld::faceNormals(Vertex *vertices, const GLuint *indices, size_t triangleCount)
+{
+    using Simd::Float4;
+    size_t t = 0;
+    for (; t + 4 <= triangleCount; t += 4) {
+        // Corner positions of the four triangles, one array per corner and axis.
+        float corners[3][3][4];
+        for (int lane = 0; lane < 4; lane++) {
+            const GLuint *triangle = indices + (t + lane) * 3;
+            for (int corner = 0; corner < 3; corner++) {
+                const glm::vec3 &p = vertices[triangle[corner]].position;
+                for (int axis = 0; axis < 3; axis++) {
+                    corners[corner][axis][lane] = p[axis];
+                }
+            }
+        }
+        Float4 ax = Float4::load(corners[0][0]), ay = Float4::load(corners[0][1]),
+               az = Float4::load(corners[0][2]);
+        Float4 ux = Float4::load(corners[1][0]) - ax, uy = Float4::load(corners[1][1]) - ay,
+               uz = Float4::load(corners[1][2]) - az;
+        Float4 vx = Float4::load(corners[2][0]) - ax, vy = Float4::load(corners[2][1]) - ay,
+               vz = Float4::load(corners[2][2]) - az;
+
+        Float4 nx = uy * vz - uz * vy;
+        Float4 ny = uz * vx - ux * vz;
+        Float4 nz = ux * vy - uy * vx;
+        Float4 len = Simd::sqrt(nx * nx + ny * ny + nz * nz);
+        Float4 zero = Float4::broadcast(0.0f);
+        nx = Simd::selectPositive(len, nx / len, zero);
+        ny = Simd::selectPositive(len, ny / len, Float4::broadcast(1.0f));
+        nz = Simd::selectPositive(len, nz / len, zero);
+
+        float normals[3][4];
+        nx.store(normals[0]);
+        ny.store(normals[1]);
+        nz.store(normals[2]);
+        for (int lane = 0; lane < 4; lane++) {
+            setNormal(vertices, indices + (t + lane) * 3,
+                      glm::vec3(normals[0][lane], normals[1][lane], normals[2][lane]));
+        }
+    }
+    faceNormalsScalar(vertices, indices + t * 3, triangleCount - t);
+}
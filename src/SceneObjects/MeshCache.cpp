@@ -0,0 +1,110 @@
+#include "SceneObjects/MeshCache.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace ParamWorld;
+
+float MeshKey::quantize(float value, float step, float min, float max)
+{
+    float lowest = std::ceil(min / step), highest = std::floor(max / step);
+    float steps = std::min(std::max(std::round(value / step), lowest), highest);
+    if (count < MaxValues) {
+        values[count++] = static_cast<int32_t>(steps);
+    }
+    if (lowest > highest) {
+        return std::min(std::max(value, min), max);
+    }
+    return steps * step;
+}
+
+std::shared_ptr<Mesh> MeshCache::get(const MeshKey &key,
+                                     const std::function<std::shared_ptr<Mesh>()> &build)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto found = _index.find(key);
+        if (found != _index.end()) {
+            _hits++;
+            _entries.splice(_entries.begin(), _entries, found->second);
+            return found->second->second;
+        }
+        _misses++;
+    }
+
+    std::shared_ptr<Mesh> built = build();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_capacity == 0) {
+        return built;
+    }
+    auto found = _index.find(key);
+    if (found != _index.end()) {
+        // Another thread built it first.
+        return found->second->second;
+    }
+    _entries.emplace_front(key, built);
+    _index[key] = _entries.begin();
+    trim();
+    return built;
+}
+
+void MeshCache::setCapacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _capacity = capacity;
+    trim();
+}
+
+size_t MeshCache::capacity() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _capacity;
+}
+
+void MeshCache::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto &entry : _entries) {
+        _retired.push_back(std::move(entry.second));
+    }
+    _entries.clear();
+    _index.clear();
+    _hits = _misses = 0;
+}
+
+void MeshCache::freeRetired()
+{
+    std::vector<std::shared_ptr<Mesh>> retired;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        retired.swap(_retired);
+    }
+    // Freed here, outside of the lock.
+}
+
+size_t MeshCache::size() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.size();
+}
+
+size_t MeshCache::hits() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _hits;
+}
+
+size_t MeshCache::misses() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _misses;
+}
+
+void MeshCache::trim()
+{
+    while (_entries.size() > _capacity) {
+        _index.erase(_entries.back().first);
+        _retired.push_back(std::move(_entries.back().second));
+        _entries.pop_back();
+    }
+}
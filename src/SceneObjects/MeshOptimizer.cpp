@@ -0,0 +1,307 @@
+#include "SceneObjects/MeshOptimizer.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+
+using namespace ParamWorld;
+
+namespace
+{
+const GLuint None = ~0u;
+
+// Vertices are the same if all of their bits are.
+bool same(const Vertex &a, const Vertex &b)
+{
+    return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+}
+
+uint64_t hash(const Vertex &v)
+{
+    uint32_t words[sizeof(Vertex) / 4];
+    std::memcpy(words, &v, sizeof(Vertex));
+    uint64_t h = 0;
+    for (uint32_t word : words) {
+        h = (h ^ word) * 0x9E3779B97F4A7C15ull;
+    }
+    return h ^ (h >> 32);
+}
+
+// Twice the triangle's area, along its normal.
+glm::vec3 areaNormal(const Vertex *vertices, const GLuint *triangle)
+{
+    glm::vec3 a = vertices[triangle[0]].position;
+    return glm::cross(vertices[triangle[1]].position - a, vertices[triangle[2]].position - a);
+}
+
+glm::vec3 centroid(const Vertex *vertices, const GLuint *triangle)
+{
+    return (vertices[triangle[0]].position + vertices[triangle[1]].position +
+            vertices[triangle[2]].position) /
+           3.0f;
+}
+
+// Splits each run of triangles that starts with a cold cache where the triangles since the
+// last split have missed at most threshold times as often as the whole run.
+void splitClusters(const GLuint *indices, size_t triangleCount, size_t vertexCount,
+                   int cacheSize, float threshold, std::vector<size_t> &clusters)
+{
+    // Same clock as optimizeVertexCache(). Moving it on by more than cacheSize empties the
+    // cache.
+    std::vector<size_t> cachedAt(vertexCount, 0);
+    size_t time = cacheSize + 1;
+    auto misses = [&](size_t t) {
+        int missed = 0;
+        for (int corner = 0; corner < 3; corner++) {
+            GLuint v = indices[t * 3 + corner];
+            if (time - cachedAt[v] > (size_t)cacheSize) {
+                cachedAt[v] = time++;
+                missed++;
+            }
+        }
+        return missed;
+    };
+
+    // clusters keeps the room optimizeVertexCache() reserved for one cluster per triangle.
+    std::vector<size_t> runs(clusters);
+    clusters.clear();
+    for (size_t r = 0; r < runs.size(); r++) {
+        size_t start = runs[r], end = (r + 1 < runs.size()) ? runs[r + 1] : triangleCount;
+        time += cacheSize + 1;
+        size_t runMisses = 0;
+        for (size_t t = start; t < end; t++) {
+            runMisses += misses(t);
+        }
+        float limit = threshold * runMisses / (end - start);
+
+        time += cacheSize + 1;
+        clusters.push_back(start);
+        size_t clusterMisses = 0;
+        for (size_t t = start; t + 1 < end; t++) {
+            clusterMisses += misses(t);
+            if (clusterMisses <= limit * (t + 1 - clusters.back())) {
+                clusters.push_back(t + 1);
+                clusterMisses = 0;
+                time += cacheSize + 1;
+            }
+        }
+    }
+}
+}
+
+size_t ParamWorld::weldVertices(const Vertex *vertices, size_t vertexCount, GLuint *indices,
+                                size_t indexCount)
+{
+    // An open addressing table of the first of each distinct vertex, at most half full.
+    size_t tableSize = 1;
+    while (tableSize < vertexCount * 2) {
+        tableSize *= 2;
+    }
+    std::vector<GLuint> table(tableSize, None);
+    std::vector<GLuint> first(vertexCount);
+    size_t welded = 0;
+    for (size_t v = 0; v < vertexCount; v++) {
+        size_t slot = hash(vertices[v]) & (tableSize - 1);
+        while (table[slot] != None && !same(vertices[table[slot]], vertices[v])) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        if (table[slot] == None) {
+            table[slot] = v;
+            first[v] = v;
+        } else {
+            first[v] = table[slot];
+            welded++;
+        }
+    }
+    for (size_t i = 0; i < indexCount; i++) {
+        indices[i] = first[indices[i]];
+    }
+    return welded;
+}
+
+void ParamWorld::optimizeVertexCache(GLuint *indices, size_t indexCount, size_t vertexCount,
+                                     int cacheSize, std::vector<size_t> *clusters,
+                                     float threshold)
+{
+    const size_t triangleCount = indexCount / 3;
+    // The triangles around each vertex, as one array with an offset per vertex, and how many
+    // of them haven't been written out yet.
+    std::vector<GLuint> live(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; i++) {
+        live[indices[i]]++;
+    }
+    std::vector<size_t> firstAround(vertexCount + 1, 0);
+    std::partial_sum(live.begin(), live.end(), firstAround.begin() + 1);
+    std::vector<GLuint> around(indexCount);
+    std::vector<size_t> fill(firstAround.begin(), firstAround.end() - 1);
+    for (size_t i = 0; i < indexCount; i++) {
+        around[fill[indices[i]]++] = i / 3;
+    }
+    GLuint mostAround = vertexCount ? *std::max_element(live.begin(), live.end()) : 0;
+
+    // When each vertex last went into the cache. It's still there while time - cachedAt is
+    // at most cacheSize.
+    std::vector<size_t> cachedAt(vertexCount, 0);
+    size_t time = cacheSize + 1;
+    std::vector<char> written(triangleCount, 0);
+    std::vector<GLuint> output, candidates, deadEnds;
+    output.reserve(indexCount);
+    candidates.reserve(3 * mostAround);
+    deadEnds.reserve(indexCount);
+    if (clusters) {
+        clusters->clear();
+        clusters->reserve(triangleCount);
+    }
+
+    size_t cursor = 0;
+    GLuint fanning = None;
+    for (;;) {
+        if (fanning == None) {
+            // Nothing nearby is left, so start again from the next vertex in the mesh.
+            while (cursor < vertexCount && live[cursor] == 0) {
+                cursor++;
+            }
+            if (cursor == vertexCount) {
+                break;
+            }
+            fanning = cursor;
+            if (clusters) {
+                clusters->push_back(output.size() / 3);
+            }
+        }
+
+        candidates.clear();
+        for (size_t a = firstAround[fanning]; a < firstAround[fanning + 1]; a++) {
+            GLuint t = around[a];
+            if (written[t]) {
+                continue;
+            }
+            written[t] = 1;
+            for (int corner = 0; corner < 3; corner++) {
+                GLuint v = indices[t * 3 + corner];
+                output.push_back(v);
+                candidates.push_back(v);
+                deadEnds.push_back(v);
+                live[v]--;
+                if (time - cachedAt[v] > (size_t)cacheSize) {
+                    cachedAt[v] = time++;
+                }
+            }
+        }
+
+        // Fan around the oldest neighbour that will still be cached after its own fan, or
+        // failing that any neighbour with triangles left.
+        fanning = None;
+        size_t best = 0;
+        for (GLuint v : candidates) {
+            if (live[v] == 0) {
+                continue;
+            }
+            size_t age = time - cachedAt[v];
+            size_t priority = (age + 2 * live[v] <= (size_t)cacheSize) ? age : 0;
+            if (fanning == None || priority > best) {
+                fanning = v;
+                best = priority;
+            }
+        }
+        // Then whatever was written most recently.
+        while (fanning == None && !deadEnds.empty()) {
+            GLuint v = deadEnds.back();
+            deadEnds.pop_back();
+            if (live[v] > 0) {
+                fanning = v;
+            }
+        }
+    }
+    std::copy(output.begin(), output.end(), indices);
+    if (clusters) {
+        splitClusters(indices, triangleCount, vertexCount, cacheSize, threshold, *clusters);
+    }
+}
+
+void ParamWorld::optimizeOverdraw(const Vertex *vertices, GLuint *indices, size_t indexCount,
+                                  const std::vector<size_t> &clusters)
+{
+    const size_t triangleCount = indexCount / 3;
+    // Triangle centroids weighted by area, so that many small triangles don't pull the
+    // middle of the mesh towards them.
+    glm::vec3 middle(0, 0, 0);
+    float totalArea = 0.0f;
+    for (size_t t = 0; t < triangleCount; t++) {
+        float area = glm::length(areaNormal(vertices, indices + t * 3));
+        middle += area * centroid(vertices, indices + t * 3);
+        totalArea += area;
+    }
+    if (totalArea > 0.0f) {
+        middle /= totalArea;
+    }
+
+    // How far out each cluster is, along the way it faces.
+    std::vector<std::pair<float, size_t>> scores;
+    scores.reserve(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++) {
+        size_t end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangleCount;
+        glm::vec3 normal(0, 0, 0), center(0, 0, 0);
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < end; t++) {
+            glm::vec3 n = areaNormal(vertices, indices + t * 3);
+            normal += n;
+            area += glm::length(n);
+            center += glm::length(n) * centroid(vertices, indices + t * 3);
+        }
+        float length = glm::length(normal);
+        float score = (area > 0.0f && length > 0.0f)
+                          ? glm::dot(center / area - middle, normal / length)
+                          : 0.0f;
+        scores.emplace_back(-score, c);
+    }
+    std::stable_sort(scores.begin(), scores.end(),
+                     [](const std::pair<float, size_t> &a, const std::pair<float, size_t> &b) {
+                         return a.first < b.first;
+                     });
+
+    std::vector<GLuint> output;
+    output.reserve(indexCount);
+    for (const auto &score : scores) {
+        size_t c = score.second;
+        size_t end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangleCount;
+        output.insert(output.end(), indices + clusters[c] * 3, indices + end * 3);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void ParamWorld::optimizeVertexFetch(std::vector<Vertex> &vertices, GLuint *indices,
+                                     size_t indexCount)
+{
+    std::vector<GLuint> renumbered(vertices.size(), None);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (size_t i = 0; i < indexCount; i++) {
+        GLuint &v = renumbered[indices[i]];
+        if (v == None) {
+            v = ordered.size();
+            ordered.push_back(vertices[indices[i]]);
+        }
+        indices[i] = v;
+    }
+    vertices.swap(ordered);
+}
+
+float ParamWorld::averageCacheMissRatio(const GLuint *indices, size_t indexCount,
+                                        size_t vertexCount, int cacheSize)
+{
+    if (indexCount < 3) {
+        return 0.0f;
+    }
+    // Same clock as optimizeVertexCache(): a vertex is cached while time - cachedAt is at
+    // most cacheSize.
+    std::vector<size_t> cachedAt(vertexCount, 0);
+    size_t time = cacheSize + 1, misses = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        if (time - cachedAt[indices[i]] > (size_t)cacheSize) {
+            cachedAt[indices[i]] = time++;
+            misses++;
+        }
+    }
+    return float(misses) / (indexCount / 3);
+}
@@ -1,110 +1,601 @@
 #include "SceneObjects/Model.hpp"
+#include "SceneObjects/FaceNormals.hpp"
+#include "SceneObjects/MeshOptimizer.hpp"
 #include <stdio.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
 
 using namespace ParamWorld;
 
+namespace
+{
+GLuint packColor(const Color &c)
+{
+    return glm::packUnorm4x8(glm::vec4(c.getRed(), c.getGreen(), c.getBlue(), 1.0f));
+}
+
+float signOf(float x) { return (x >= 0.0f) ? 1.0f : -1.0f; }
+
+// Packs a unit vector into two signed bytes by projecting it onto an octahedron, then
+// unfolding the lower half of the octahedron over the corners of the upper half.
+GLushort packOctahedral(glm::vec3 n)
+{
+    float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (sum == 0.0f) {
+        return glm::packSnorm2x8(glm::vec2(0, 0));
+    }
+    n /= sum;
+    glm::vec2 p(n.x, n.y);
+    if (n.z < 0.0f) {
+        p = glm::vec2((1.0f - std::fabs(n.y)) * signOf(n.x), (1.0f - std::fabs(n.x)) * signOf(n.y));
+    }
+    return glm::packSnorm2x8(p);
+}
+
+glm::vec3 unpackOctahedral(GLushort packed)
+{
+    glm::vec2 p = glm::unpackSnorm2x8(packed);
+    glm::vec3 n(p.x, p.y, 1.0f - std::fabs(p.x) - std::fabs(p.y));
+    if (n.z < 0.0f) {
+        n.x = (1.0f - std::fabs(p.y)) * signOf(p.x);
+        n.y = (1.0f - std::fabs(p.x)) * signOf(p.y);
+    }
+    return glm::normalize(n);
+}
+
+CompactVertex compress(glm::vec3 position, glm::vec3 normal, GLuint color, glm::vec3 origin)
+{
+    glm::vec3 p = position - origin;
+    return {{glm::packHalf1x16(p.x), glm::packHalf1x16(p.y), glm::packHalf1x16(p.z)},
+            packOctahedral(normal),
+            color};
+}
+
+CompactVertex compress(const Vertex &v, glm::vec3 origin)
+{
+    return compress(v.position, glm::vec3(glm::unpackSnorm3x10_1x2(v.normal)), v.color, origin);
+}
+
+Vertex expand(const CompactVertex &v, glm::vec3 origin)
+{
+    glm::vec3 p(glm::unpackHalf1x16(v.position[0]), glm::unpackHalf1x16(v.position[1]),
+                glm::unpackHalf1x16(v.position[2]));
+    glm::vec3 n = unpackOctahedral(v.normal);
+    return {p + origin, v.color, glm::packSnorm3x10_1x2(glm::vec4(n, 0.0f))};
+}
+}
+
+Model::Model(Model &&other)
+    : _vertexbuffer(other._vertexbuffer),
+      _indexbuffer(other._indexbuffer),
+      _instancebuffer(other._instancebuffer),
+      _vertexArray(other._vertexArray),
+      _instanceArray(other._instanceArray),
+      _format(other._format),
+      _origin(other._origin),
+      _vertices(std::move(other._vertices)),
+      _compactVertices(std::move(other._compactVertices)),
+      _indices(std::move(other._indices)),
+      _instances(std::move(other._instances)),
+      _bounds(other._bounds),
+      _deferNormals(other._deferNormals),
+      _normalsFrom(other._normalsFrom)
+{
+    std::copy(other._bufferBytes, other._bufferBytes + 3, _bufferBytes);
+    std::copy(other._sentBytes, other._sentBytes + 3, _sentBytes);
+    other._vertexbuffer = other._indexbuffer = other._instancebuffer = 0;
+    other._vertexArray = other._instanceArray = 0;
+    other._bounds = Bounds();
+    std::fill(other._bufferBytes, other._bufferBytes + 3, 0);
+    std::fill(other._sentBytes, other._sentBytes + 3, 0);
+}
+
+Model &Model::operator=(Model &&other)
+{
+    if (this != &other) {
+        std::swap(_vertexbuffer, other._vertexbuffer);
+        std::swap(_indexbuffer, other._indexbuffer);
+        std::swap(_instancebuffer, other._instancebuffer);
+        std::swap(_vertexArray, other._vertexArray);
+        std::swap(_instanceArray, other._instanceArray);
+        std::swap(_format, other._format);
+        std::swap(_origin, other._origin);
+        std::swap(_vertices, other._vertices);
+        std::swap(_compactVertices, other._compactVertices);
+        std::swap(_indices, other._indices);
+        std::swap(_instances, other._instances);
+        std::swap(_bounds, other._bounds);
+        std::swap(_deferNormals, other._deferNormals);
+        std::swap(_normalsFrom, other._normalsFrom);
+        std::swap(_bufferBytes, other._bufferBytes);
+        std::swap(_sentBytes, other._sentBytes);
+    }
+    return *this;
+}
+
+Model::~Model()
+{
+    // Buffers are only made once InitBuffer is called, so there's no GL work otherwise.
+    GLuint buffers[] = {_vertexbuffer, _indexbuffer, _instancebuffer};
+    for (GLuint buffer : buffers) {
+        if (buffer != 0) {
+            glDeleteBuffers(1, &buffer);
+        }
+    }
+    GLuint arrays[] = {_vertexArray, _instanceArray};
+    for (GLuint array : arrays) {
+        if (array != 0) {
+            glDeleteVertexArrays(1, &array);
+        }
+    }
+}
+
 void Model::InitBuffer()
 {
-    glGenBuffers(1, &_vertexbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, _vertexbuffer);
-    glBufferData(GL_ARRAY_BUFFER,
-                 _vertices.size() * 4,  // number of elements times their size
-                 &_vertices[0], GL_STATIC_DRAW);
+    beginUpload();
+    uploadSome(uploadSize());
+}
+
+size_t Model::uploadSize() const
+{
+    return vertexBytes() + _indices.size() * sizeof(GLuint) +
+           _instances.size() * sizeof(BoxInstance);
+}
+
+const void *Model::vertexData() const
+{
+    if (_format == VertexFormat::Full) {
+        return _vertices.data();
+    }
+    return _compactVertices.data();
+}
 
-    glGenBuffers(1, &_colorbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, _colorbuffer);
-    glBufferData(GL_ARRAY_BUFFER, _colors.size() * 4, &_colors[0], GL_STATIC_DRAW);
+size_t Model::vertexBytes() const
+{
+    if (_format == VertexFormat::Full) {
+        return _vertices.size() * sizeof(Vertex);
+    }
+    return _compactVertices.size() * sizeof(CompactVertex);
+}
 
-    glGenBuffers(1, &_normalbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, _normalbuffer);
-    glBufferData(GL_ARRAY_BUFFER, _normals.size() * sizeof(glm::vec3), &_normals[0],
+size_t Model::partBytes(int part) const
+{
+    switch (part) {
+        case 0:
+            return vertexBytes();
+        case 1:
+            return _indices.size() * sizeof(GLuint);
+        default:
+            return _instances.size() * sizeof(BoxInstance);
+    }
+}
+
+const char *Model::partData(int part) const
+{
+    switch (part) {
+        case 0:
+            return reinterpret_cast<const char *>(vertexData());
+        case 1:
+            return reinterpret_cast<const char *>(_indices.data());
+        default:
+            return reinterpret_cast<const char *>(_instances.data());
+    }
+}
+
+GLuint &Model::partBuffer(int part)
+{
+    GLuint *buffers[] = {&_vertexbuffer, &_indexbuffer, &_instancebuffer};
+    return *buffers[part];
+}
+
+bool Model::uploaded() const
+{
+    for (int part = 0; part < 3; part++) {
+        if (_sentBytes[part] != partBytes(part)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Model::beginUpload()
+{
+    fillNormals();
+    if (_vertexbuffer == 0) {
+        glGenBuffers(1, &_vertexbuffer);
+        glGenBuffers(1, &_indexbuffer);
+        glGenVertexArrays(1, &_vertexArray);
+    }
+    // The index buffer binding belongs to the vertex array, so bind ours before touching it.
+    glBindVertexArray(_vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, _vertexbuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes(), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexbuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, _indices.size() * sizeof(GLuint), nullptr,
                  GL_STATIC_DRAW);
+    setupVertexArray();
+
+    if (!_instances.empty()) {
+        if (_instancebuffer == 0) {
+            glGenBuffers(1, &_instancebuffer);
+            glGenVertexArrays(1, &_instanceArray);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, _instancebuffer);
+        glBufferData(GL_ARRAY_BUFFER, _instances.size() * sizeof(BoxInstance), nullptr,
+                     GL_STATIC_DRAW);
+        setupInstanceArray();
+    }
+    for (int part = 0; part < 3; part++) {
+        _bufferBytes[part] = partBytes(part);
+        _sentBytes[part] = 0;
+    }
 }
 
-void Model::drawBuffer() const
+size_t Model::uploadSome(size_t maxBytes)
 {
-    glEnableVertexAttribArray(0);
+    const GLenum targets[] = {GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_ARRAY_BUFFER};
+    size_t sent = 0;
+    glBindVertexArray(_vertexArray);
+    for (int part = 0; part < 3 && sent < maxBytes; part++) {
+        size_t bytes = partBytes(part), offset = _sentBytes[part];
+        if (offset < bytes) {
+            size_t count = std::min(bytes - offset, maxBytes - sent);
+            glBindBuffer(targets[part], partBuffer(part));
+            glBufferSubData(targets[part], offset, count, partData(part) + offset);
+            _sentBytes[part] += count;
+            sent += count;
+        }
+        // Indices only go once all of the vertices are there, so the ones that are drawn
+        // never point past what has arrived.
+        if (_sentBytes[part] < bytes) {
+            break;
+        }
+    }
+    return sent;
+}
+
+size_t Model::uploadAppended(size_t maxBytes)
+{
+    growBuffers();
+    return uploadSome(maxBytes);
+}
+
+void Model::growBuffers()
+{
+    if (_vertexArray == 0) {
+        glGenVertexArrays(1, &_vertexArray);
+    }
+    bool moved[3] = {false, false, false};
+    for (int part = 0; part < 3; part++) {
+        size_t bytes = partBytes(part);
+        if (bytes <= _bufferBytes[part] && (bytes == 0 || partBuffer(part) != 0)) {
+            continue;
+        }
+        size_t capacity = std::max(bytes, 2 * _bufferBytes[part]);
+        GLuint grown;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
+        GLuint &buffer = partBuffer(part);
+        if (buffer != 0) {
+            if (_sentBytes[part] > 0) {
+                glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                                    _sentBytes[part]);
+            }
+            glDeleteBuffers(1, &buffer);
+        }
+        buffer = grown;
+        _bufferBytes[part] = capacity;
+        moved[part] = true;
+    }
+    if (moved[0] || moved[1]) {
+        // The index buffer binding belongs to the vertex array, like in beginUpload().
+        glBindVertexArray(_vertexArray);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexbuffer);
+        if (_vertexbuffer != 0) {
+            setupVertexArray();
+        }
+    }
+    if (moved[2]) {
+        if (_instanceArray == 0) {
+            glGenVertexArrays(1, &_instanceArray);
+        }
+        setupInstanceArray();
+    }
+}
+
+const Model &Model::unitCube()
+{
+    // Never freed, since there's no GL context left to free it with at exit.
+    static Model *cube = nullptr;
+    if (cube == nullptr) {
+        cube = new Model();
+        cube->AddBoxFromCenter(Color(1.0f, 1.0f, 1.0f), glm::vec3(0, 0, 0), glm::vec3(1, 1, 1));
+        cube->InitBuffer();
+    }
+    return *cube;
+}
+
+void Model::setupVertexArray()
+{
+    // Called with the vertex array bound.
     glBindBuffer(GL_ARRAY_BUFFER, _vertexbuffer);
-    glVertexAttribPointer(0,  // attribute 0, no reason for 0, but must match layout in shader
-                          3,  // size
-                          GL_FLOAT,  // type
-                          GL_FALSE,  // normalized
-                          0,         // stride
-                          nullptr    // array buffer offset
-                          );
-
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, _colorbuffer);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-    // 3rd attribute buffer : normals
+    if (_format == VertexFormat::Compact) {
+        // The shader sees the same vec3 position and color, GL does the unpacking. The
+        // normal comes through as its two octahedral coordinates.
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex),
+                              reinterpret_cast<void *>(offsetof(CompactVertex, position)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CompactVertex),
+                              reinterpret_cast<void *>(offsetof(CompactVertex, color)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_BYTE, GL_TRUE, sizeof(CompactVertex),
+                              reinterpret_cast<void *>(offsetof(CompactVertex, normal)));
+    } else {
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0,  // attribute 0, no reason for 0, but must match layout in shader
+                              3,  // size
+                              GL_FLOAT,  // type
+                              GL_FALSE,  // normalized
+                              sizeof(Vertex),  // stride
+                              reinterpret_cast<void *>(offsetof(Vertex, position))  // offset
+                              );
+
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+                              reinterpret_cast<void *>(offsetof(Vertex, color)));
+
+        // 3rd attribute : normals
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2,                        // attribute
+                              4,                        // size
+                              GL_INT_2_10_10_10_REV,    // type
+                              GL_TRUE,                  // normalized?
+                              sizeof(Vertex),           // stride
+                              reinterpret_cast<void *>(offsetof(Vertex, normal))  // offset
+                              );
+    }
+}
+
+void Model::setupInstanceArray()
+{
+    const Model &cube = unitCube();
+    glBindVertexArray(_instanceArray);
+    // Per vertex attributes of the cube: positions and normals.
+    glBindBuffer(GL_ARRAY_BUFFER, cube._vertexbuffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          reinterpret_cast<void *>(offsetof(Vertex, position)));
     glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, _normalbuffer);
-    glVertexAttribPointer(2,         // attribute
-                          3,         // size
-                          GL_FLOAT,  // type
-                          GL_FALSE,  // normalized?
-                          0,         // stride
-                          nullptr    // array buffer offset
-                          );
+    glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(Vertex),
+                          reinterpret_cast<void *>(offsetof(Vertex, normal)));
+
+    // Per instance attributes: center, size, rotation and color.
+    glBindBuffer(GL_ARRAY_BUFFER, _instancebuffer);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(BoxInstance),
+                          reinterpret_cast<void *>(offsetof(BoxInstance, center)));
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(BoxInstance),
+                          reinterpret_cast<void *>(offsetof(BoxInstance, size)));
+    glEnableVertexAttribArray(5);
+    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(BoxInstance),
+                          reinterpret_cast<void *>(offsetof(BoxInstance, rotation)));
+    glEnableVertexAttribArray(6);
+    glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(BoxInstance),
+                          reinterpret_cast<void *>(offsetof(BoxInstance, color)));
+    for (GLuint attrib = 3; attrib <= 6; attrib++) {
+        glVertexAttribDivisor(attrib, 1);
+    }
 
-    glDrawArrays(GL_TRIANGLES, 0, _vertices.size() / 3);
-    glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cube._indexbuffer);
 }
 
-void Model::AddBoxFromCorner(float x1, float y1, float z1, float x2, float y2, float z2, Color c)
+void Model::drawBuffer() const
 {
-    // Order the inputs.
-    float t;
-    if (x1 > x2) {
-        t = x1;
-        x1 = x2;
-        x2 = t;
-    }
-    if (y1 > y2) {
-        t = y1;
-        y1 = y2;
-        y2 = t;
-    }
-    if (z1 > z2) {
-        t = z1;
-        z1 = z2;
-        z2 = t;
-    }
-    float vs[] = {
-        x1, y1, z1, x1, y1, z2, x1, y2, z2, x1, y2, z2, x1, y2, z1, x1, y1, z1,  // left face end
-        x2, y1, z1, x2, y1, z2, x2, y2, z2, x2, y2, z2, x2, y2, z1, x2, y1, z1,  // right face end
-        x1, y1, z1, x1, y1, z2, x2, y1, z2, x2, y1, z2, x2, y1, z1, x1, y1, z1,  // bottom face end
-        x1, y2, z1, x1, y2, z2, x2, y2, z2, x2, y2, z2, x2, y2, z1, x1, y2, z1,  // top face end
-        x1, y1, z1, x1, y2, z1, x2, y2, z1, x2, y2, z1, x2, y1, z1, x1, y1, z1,  // back face end
-        x1, y1, z2, x1, y2, z2, x2, y2, z2, x2, y2, z2, x2, y1, z2, x1, y1, z2,  // back face end
-    };
+    // Only whole triangles that have been uploaded.
+    size_t count = _sentBytes[1] / sizeof(GLuint) / 3 * 3;
+    if (count == 0) {
+        return;
+    }
+    glBindVertexArray(_vertexArray);
+    glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, nullptr);
+}
 
-    //_vertices.insert(_vertices.end(), temp.begin(), temp.end());
-    for (int i = 0; i < 12; i++) {  // loop per triangle
-        // Calculate normal for triangle.
-        glm::vec3 one(vs[i], vs[i + 1], vs[i + 2]);
-        glm::vec3 two(vs[i + 3], vs[i + 4], vs[i + 5]);
-        glm::vec3 three(vs[i + 6], vs[i + 7], vs[i + 9]);
-        glm::vec3 edge1 = two - one;
-        glm::vec3 edge2 = three - one;
-        glm::vec3 n = glm::normalize(glm::cross(edge1, edge2));
-        for (int j = 0; j < 3; j++) {  // loop per vertex
-            // Add 3 coordinates for vertex.
-            for (int k = 0; k < 3; k++) {  // loop per number
-                _vertices.push_back(vs[i * 9 + j * 3 + k]);
-            }
-            // Add colors for vertex.
-            _colors.push_back(c.getRed());
-            _colors.push_back(c.getGreen());
-            _colors.push_back(c.getBlue());
-            // Add normal for vertex.
-            _normals.push_back(n[0]);
-            _normals.push_back(n[1]);
-            _normals.push_back(n[2]);
+void Model::drawInstances() const
+{
+    size_t count = _sentBytes[2] / sizeof(BoxInstance);
+    if (count == 0) {
+        return;
+    }
+    glBindVertexArray(_instanceArray);
+    glDrawElementsInstanced(GL_TRIANGLES, unitCube()._indices.size(), GL_UNSIGNED_INT, nullptr,
+                            count);
+}
+
+GLuint Model::AddVertex(glm::vec3 position, GLuint color, GLuint normal)
+{
+    if (_format == VertexFormat::Full) {
+        _vertices.push_back({position, color, normal});
+    } else {
+        _compactVertices.push_back(compress({position, color, normal}, _origin));
+    }
+    _bounds.extend(position);
+    return vertexCount() - 1;
+}
+
+Vertex Model::vertex(size_t i) const
+{
+    if (_format == VertexFormat::Full) {
+        return _vertices[i];
+    }
+    return expand(_compactVertices[i], _origin);
+}
+
+void Model::setVertexFormat(VertexFormat format, glm::vec3 origin)
+{
+    fillNormals();
+    std::vector<Vertex> full;
+    if (_format == VertexFormat::Full) {
+        full.swap(_vertices);
+    } else {
+        full.reserve(_compactVertices.size());
+        for (size_t i = 0; i < _compactVertices.size(); i++) {
+            full.push_back(vertex(i));
+        }
+        std::vector<CompactVertex>().swap(_compactVertices);
+    }
+
+    _format = format;
+    if (format == VertexFormat::Full) {
+        _origin = glm::vec3(0, 0, 0);
+        _vertices.swap(full);
+    } else {
+        _origin = origin;
+        _compactVertices.reserve(full.size());
+        for (const Vertex &v : full) {
+            _compactVertices.push_back(compress(v, _origin));
+        }
+    }
+}
+
+void Model::optimize(int cacheSize)
+{
+    if (_format != VertexFormat::Full) {
+        return;
+    }
+    fillNormals();
+    std::vector<size_t> clusters;
+    weldVertices(_vertices.data(), _vertices.size(), _indices.data(), _indices.size());
+    optimizeVertexCache(_indices.data(), _indices.size(), _vertices.size(), cacheSize,
+                        &clusters);
+    optimizeOverdraw(_vertices.data(), _indices.data(), _indices.size(), clusters);
+    optimizeVertexFetch(_vertices, _indices.data(), _indices.size());
+}
+
+void Model::deferNormals()
+{
+    if (!_deferNormals) {
+        _deferNormals = true;
+        _normalsFrom = _indices.size();
+    }
+}
+
+void Model::fillNormals()
+{
+    if (!_deferNormals) {
+        return;
+    }
+    _deferNormals = false;
+    if (_format == VertexFormat::Full && _normalsFrom < _indices.size()) {
+        faceNormals(_vertices.data(), &_indices[_normalsFrom],
+                    (_indices.size() - _normalsFrom) / 3);
+    }
+}
+
+void Model::AddFace(const glm::vec3 *corners, int count, bool flip, GLuint color)
+{
+    // Write the whole face straight into the arrays instead of pushing it a value at a time.
+    // Full normals are filled in afterwards by faceNormals(), for all of a shape's faces at
+    // once, or of every shape since deferNormals(). Compact ones are packed with the rest of the vertex, from the face's normal.
+    size_t first = vertexCount();
+    if (_format == VertexFormat::Full) {
+        _vertices.resize(first + count);
+        Vertex *v = &_vertices[first];
+        for (int i = 0; i < count; i++) {
+            v[i] = {corners[i], color, 0};
+        }
+    } else {
+        glm::vec3 n = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+        float length = glm::length(n);
+        n = (length > 0.0f) ? n / (flip ? -length : length) : glm::vec3(0, 1, 0);
+        _compactVertices.resize(first + count);
+        CompactVertex *v = &_compactVertices[first];
+        for (int i = 0; i < count; i++) {
+            v[i] = compress(corners[i], n, color, _origin);
         }
     }
+    for (int i = 0; i < count; i++) {
+        _bounds.extend(corners[i]);
+    }
+    // Fan the corners into triangles.
+    size_t firstIndex = _indices.size();
+    _indices.resize(firstIndex + (count - 2) * 3);
+    GLuint *index = &_indices[firstIndex];
+    for (int i = 1; i + 1 < count; i++) {
+        *index++ = first;
+        *index++ = first + (flip ? i + 1 : i);
+        *index++ = first + (flip ? i : i + 1);
+    }
+}
+
+void Model::reserve(Primitive kind, size_t count)
+{
+    size_t vertices = 0, indices = 0;
+    switch (kind) {
+        case Primitive::Box:
+            // 6 quads, each 4 vertices and 2 triangles.
+            vertices = count * 24;
+            indices = count * 36;
+            break;
+        case Primitive::Tetra:
+            // 4 triangles that don't share vertices.
+            vertices = count * 12;
+            indices = count * 12;
+            break;
+        case Primitive::Triangle:
+            vertices = count * 3;
+            indices = count * 3;
+            break;
+        case Primitive::BoxInstance:
+            _instances.reserve(_instances.size() + count);
+            return;
+    }
+    if (_format == VertexFormat::Full) {
+        _vertices.reserve(_vertices.size() + vertices);
+    } else {
+        _compactVertices.reserve(_compactVertices.size() + vertices);
+    }
+    _indices.reserve(_indices.size() + indices);
+}
+
+void Model::AddBox(const glm::vec3 corners[8], Color c)
+{
+    // Corners of each face, in counter-clockwise order when seen from outside.
+    static const int faces[6][4] = {
+        {0, 4, 6, 2},  // left face
+        {1, 3, 7, 5},  // right face
+        {0, 1, 5, 4},  // bottom face
+        {2, 6, 7, 3},  // top face
+        {0, 2, 3, 1},  // back face
+        {4, 5, 7, 6},  // front face
+    };
+    // A box with a negative size is turned inside out, so its faces need to be flipped.
+    bool flip = glm::dot(glm::cross(corners[1] - corners[0], corners[2] - corners[0]),
+                         corners[4] - corners[0]) < 0.0f;
+    size_t firstIndex = _indices.size();
+    GLuint color = packColor(c);
+    for (auto &face : faces) {
+        glm::vec3 quad[4] = {corners[face[0]], corners[face[1]], corners[face[2]],
+                             corners[face[3]]};
+        AddFace(quad, 4, flip, color);
+    }
+    if (_format == VertexFormat::Full && !_deferNormals) {
+        faceNormals(_vertices.data(), &_indices[firstIndex], (_indices.size() - firstIndex) / 3);
+    }
+}
+
+void Model::AddBoxFromCorner(float x1, float y1, float z1, float x2, float y2, float z2, Color c)
+{
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; i++) {
+        corners[i] = glm::vec3((i & 1) ? x2 : x1, (i & 2) ? y2 : y1, (i & 4) ? z2 : z1);
+    }
+    AddBox(corners, c);
 }
 
 void Model::AddBoxFromCorner(Color c, glm::vec3 origin, glm::vec3 size)
@@ -119,130 +610,106 @@ void Model::AddBoxFromCenter(Color c, glm::vec3 origin, glm::vec3 size)
     AddBoxFromCorner(o[0], o[1], o[2], o[0] + size[0], o[1] + size[1], o[2] + size[2], c);
 }
 
-void Model::AddTetra(Color color, glm::vec3 top, glm::vec3 l, glm::vec3 r, glm::vec3 b)
-{
-    float vs[] = {top[0], top[1], top[2], l[0], l[1], l[2], r[0], r[1], r[2],
-                  top[0], top[1], top[2], b[0], b[1], b[2], l[0], l[1], l[2],
-                  top[0], top[1], top[2], b[0], b[1], b[2], r[0], r[1], r[2],
-                  top[0], top[1], top[2], b[0], b[1], b[2], r[0], r[1], r[2]};
-    for (int i = 0; i < 4; i++) {  // loop per triangle
-        // Calculate normal for triangle.
-        glm::vec3 one(vs[i], vs[i + 1], vs[i + 2]);
-        glm::vec3 two(vs[i + 3], vs[i + 4], vs[i + 5]);
-        glm::vec3 three(vs[i + 6], vs[i + 7], vs[i + 9]);
-        glm::vec3 edge1 = two - one;
-        glm::vec3 edge2 = three - one;
-        glm::vec3 n = glm::normalize(glm::cross(edge1, edge2));
-        for (int j = 0; j < 3; j++) {  // loop per vertex
-            // Add 3 coordinates for vertex.
-            for (int k = 0; k < 3; k++) {  // loop per number
-                _vertices.push_back(vs[i * 9 + j * 3 + k]);
-            }
-            // Add colors for vertex.
-            _colors.push_back(color.getRed());
-            _colors.push_back(color.getGreen());
-            _colors.push_back(color.getBlue());
-            // Add normal for vertex.
-            _normals.push_back(n[0]);
-            _normals.push_back(n[1]);
-            _normals.push_back(n[2]);
-        }
+void Model::AddTetra(Color color, glm::vec3 top, glm::vec3 l, glm::vec3 r, glm::vec3 b,
+                     TetraFaces faces)
+{
+    glm::vec3 corners[4][3] = {{top, l, r}, {top, r, b}, {top, b, l}, {l, r, b}};
+    // The three sides are wound one way and the base the other, so one orientation test
+    // says which of them face outward.
+    bool flipSides = glm::dot(glm::cross(l - top, r - top), b - top) > 0.0f;
+    int first = (faces == TetraFaces::Base) ? 3 : 0;
+    int end = (faces == TetraFaces::Sides) ? 3 : 4;
+    size_t firstIndex = _indices.size();
+    GLuint c = packColor(color);
+    for (int i = first; i < end; i++) {
+        AddFace(corners[i], 3, (i < 3) ? flipSides : !flipSides, c);
+    }
+    if (_format == VertexFormat::Full && !_deferNormals) {
+        faceNormals(_vertices.data(), &_indices[firstIndex], end - first);
     }
-    // std::vector<float> temp(verts, verts+(3*12));
-    //_vertices.insert(_vertices.end(), temp.begin(), temp.end());
-    // for (int i = 0; i < 12; i++) {
-    //    _colors.push_back(color.getRed());
-    //    _colors.push_back(color.getGreen());
-    //    _colors.push_back(color.getBlue());
-    //}
 }
 
 void Model::AddBoxFromCenter(Color c, glm::vec3 center, glm::vec3 size, glm::fquat rotation)
 {
     glm::vec3 s = size * 0.5f;
-    glm::vec3 o = center;
-    std::vector<glm::vec3> vecsOToPs;
-    vecsOToPs.push_back(glm::vec3(-s[0], s[1], -s[2]));
-    vecsOToPs.push_back(glm::vec3(s[0], s[1], -s[2]));
-    vecsOToPs.push_back(glm::vec3(-s[0], -s[1], -s[2]));
-    vecsOToPs.push_back(glm::vec3(s[0], -s[1], -s[2]));
-    vecsOToPs.push_back(glm::vec3(-s[0], s[1], s[2]));
-    vecsOToPs.push_back(glm::vec3(s[0], s[1], s[2]));
-    vecsOToPs.push_back(glm::vec3(-s[0], -s[1], s[2]));
-    vecsOToPs.push_back(glm::vec3(s[0], -s[1], s[2]));
-
-    std::vector<glm::vec3> vs;
-    for (auto& vecsOToP : vecsOToPs) {
-        vs.push_back(glm::rotate(rotation, vecsOToP) + o);
-    }
-
-    float verts[] = {
-        vs[3][0], vs[3][1], vs[3][2], vs[1][0], vs[1][1], vs[1][2],
-        vs[0][0], vs[0][1], vs[0][2], vs[0][0], vs[0][1], vs[0][2],
-        vs[2][0], vs[2][1], vs[2][2], vs[3][0], vs[3][1], vs[3][2],  // face 1 end
-
-        vs[6][0], vs[6][1], vs[6][2], vs[4][0], vs[4][1], vs[4][2],
-        vs[5][0], vs[5][1], vs[5][2], vs[4][0], vs[4][1], vs[4][2],
-        vs[7][0], vs[7][1], vs[7][2], vs[6][0], vs[6][1], vs[6][2],  // face 2 end
-
-        vs[6][0], vs[6][1], vs[6][2], vs[2][0], vs[2][1], vs[2][2],
-        vs[0][0], vs[0][1], vs[0][2], vs[0][0], vs[0][1], vs[0][2],
-        vs[4][0], vs[4][1], vs[4][2], vs[6][0], vs[6][1], vs[6][2],  // face 3 end
-
-        vs[7][0], vs[7][1], vs[7][2], vs[5][0], vs[5][1], vs[5][2],
-        vs[1][0], vs[1][1], vs[1][2], vs[1][0], vs[1][1], vs[1][2],
-        vs[3][0], vs[3][1], vs[3][2], vs[7][0], vs[7][1], vs[7][2],  // face 4 end
-
-        vs[3][0], vs[3][1], vs[3][2], vs[2][0], vs[2][1], vs[2][2],
-        vs[6][0], vs[6][1], vs[6][2], vs[6][0], vs[6][1], vs[6][2],
-        vs[7][0], vs[7][1], vs[7][2], vs[3][0], vs[3][1], vs[3][2],  // face 5 end
-
-        vs[0][0], vs[0][1], vs[0][2], vs[1][0], vs[1][1], vs[1][2],
-        vs[5][0], vs[5][1], vs[5][2], vs[5][0], vs[5][1], vs[5][2],
-        vs[4][0], vs[4][1], vs[4][2], vs[0][0], vs[0][1], vs[0][2]  // face 6 end
-    };
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 vecOToP((i & 1) ? s[0] : -s[0], (i & 2) ? s[1] : -s[1], (i & 4) ? s[2] : -s[2]);
+        corners[i] = glm::rotate(rotation, vecOToP) + center;
+    }
+    AddBox(corners, c);
+}
 
-    for (int i = 0; i < 12; i++) {  // loop per triangle
-        // Calculate normal for triangle.
-        glm::vec3 one(verts[i], verts[i + 1], verts[i + 2]);
-        glm::vec3 two(verts[i + 3], verts[i + 4], verts[i + 5]);
-        glm::vec3 three(verts[i + 6], verts[i + 7], verts[i + 9]);
-        glm::vec3 edge1 = two - one;
-        glm::vec3 edge2 = three - one;
-        glm::vec3 n = glm::normalize(glm::cross(edge1, edge2));
-        for (int j = 0; j < 3; j++) {  // loop per vertex
-            // Add 3 coordinates for vertex.
-            for (int k = 0; k < 3; k++) {  // loop per number
-                _vertices.push_back(verts[i * 9 + j * 3 + k]);
-            }
-            // Add colors for vertex.
-            _colors.push_back(c.getRed());
-            _colors.push_back(c.getGreen());
-            _colors.push_back(c.getBlue());
-            // Add normal for vertex.
-            _normals.push_back(n[0]);
-            _normals.push_back(n[1]);
-            _normals.push_back(n[2]);
+void Model::AddBoxInstance(Color c, glm::vec3 center, glm::vec3 size, glm::fquat rotation)
+{
+    _instances.push_back(MakeBoxInstance(c, center, size, rotation));
+    extendBounds(_instances.back());
+}
+
+void Model::AddBoxInstances(const BoxInstance *instances, size_t count)
+{
+    _instances.insert(_instances.end(), instances, instances + count);
+    for (size_t i = 0; i < count; i++) {
+        extendBounds(instances[i]);
+    }
+}
+
+BoxInstance Model::MakeBoxInstance(Color c, glm::vec3 center, glm::vec3 size,
+                                   glm::fquat rotation)
+{
+    return {center, size, glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w),
+            packColor(c)};
+}
+
+void Model::extendBounds(const BoxInstance &instance) { _bounds.extend(boundsOf(instance)); }
+
+Bounds Model::boundsOf(const BoxInstance &instance)
+{
+    const glm::vec4 &r = instance.rotation;
+    glm::mat3 turn = glm::mat3_cast(glm::fquat(r.w, r.x, r.y, r.z));
+    // Half of the extent of the turned box along each axis.
+    glm::vec3 half(0, 0, 0);
+    for (int axis = 0; axis < 3; axis++) {
+        for (int i = 0; i < 3; i++) {
+            half[i] += std::fabs(turn[axis][i]) * instance.size[axis] * 0.5f;
         }
     }
-    /*
-    std::vector<float> temp(verts, verts+(3*36));
-    _vertices.insert(_vertices.end(), temp.begin(), temp.end());
-    for (int i = 0; i < 36; i++) {
-        _colors.push_back(c.getRed());
-        _colors.push_back(c.getGreen());
-        _colors.push_back(c.getBlue());
-    }
-    */
-}
-
-/*uint16_t Model::AddVertex(float x, float y, float z, const Color& c) {
-    g_vertex_buffer_data.push_back(x);
-    g_vertex_buffer_data.push_back(y);
-    g_vertex_buffer_data.push_back(z);
-    g_color_buffer_data.push_back(c.getRed());
-    g_color_buffer_data.push_back(c.getGreen());
-    g_color_buffer_data.push_back(c.getBlue());
-    // TODO: change
-    return 0;
-} */
+    Bounds b;
+    b.extend(instance.center - half);
+    b.extend(instance.center + half);
+    return b;
+}
+
+void Model::Append(const Model &other, const glm::mat4 &transform)
+{
+    glm::mat3 normalTransform(transform);
+    GLuint first = vertexCount();
+    if (_format == VertexFormat::Full) {
+        _vertices.reserve(_vertices.size() + other.vertexCount());
+    } else {
+        _compactVertices.reserve(_compactVertices.size() + other.vertexCount());
+    }
+    for (size_t i = 0; i < other.vertexCount(); i++) {
+        Vertex v = other.vertex(i);
+        glm::vec3 n(glm::unpackSnorm3x10_1x2(v.normal));
+        n = glm::normalize(normalTransform * n);
+        AddVertex(glm::vec3(transform * glm::vec4(v.position, 1.0f)), v.color,
+                  glm::packSnorm3x10_1x2(glm::vec4(n, 0.0f)));
+    }
+    _indices.reserve(_indices.size() + other._indices.size());
+    for (GLuint index : other._indices) {
+        _indices.push_back(first + index);
+    }
+
+    glm::fquat turn = glm::quat_cast(normalTransform);
+    _instances.reserve(_instances.size() + other._instances.size());
+    for (const BoxInstance &instance : other._instances) {
+        const glm::vec4 &r = instance.rotation;
+        glm::fquat rotation = turn * glm::fquat(r.w, r.x, r.y, r.z);
+        _instances.push_back({glm::vec3(transform * glm::vec4(instance.center, 1.0f)),
+                              instance.size,
+                              glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w),
+                              instance.color});
+        extendBounds(_instances.back());
+    }
+}
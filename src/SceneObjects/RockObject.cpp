@@ -3,38 +3,96 @@
 
 using namespace ParamWorld;
 
+std::atomic<bool> RockObject::keepHiddenFaces(false);
+std::atomic<bool> RockObject::optimizeMeshes(true);
+
 // Forcing it to be on the ground.
 RockObject::RockObject(int depth, Color color, glm::vec3 root, glm::vec2 a, glm::vec2 b,
-                       glm::vec2 c, float heightMult)
-    : SceneObject(ParamArray<SP_Count>(), root, new Linear(glfwGetTime(), glfwGetTime() + 5.0)),
+                       glm::vec2 c, float heightMult, uint64_t seed)
+    : SceneObject(ParamArray<SP_Count>(), root,
+                  Function::linear(glfwGetTime(), glfwGetTime() + 5.0)),
       _depth(depth),
       _color1(color),
       _color2(color.shiftUp(SHADE)),
       _color3(color.shiftDown(SHADE)),
-      _heightMult(heightMult)
+      _heightMult(heightMult),
+      _random(seed)
 {
-    Init(depth, glm::vec3(a[0], 0, a[1]), glm::vec3(b[0], 0, b[1]), glm::vec3(c[0], 0, c[1]));
+    Build(glm::vec3(a[0], 0, a[1]), glm::vec3(b[0], 0, b[1]), glm::vec3(c[0], 0, c[1]));
 }
 
 RockObject::RockObject(glm::vec3 root, glm::vec2 a, glm::vec2 b, glm::vec2 c,
-                       ParamArray<SP_Count> params)
-    : SceneObject(params, root, new Linear(glfwGetTime(), glfwGetTime() + 5.0)),
+                       ParamArray<SP_Count> params, uint64_t seed)
+    : SceneObject(params, root, Function::linear(glfwGetTime(), glfwGetTime() + 5.0)),
       _depth((int)params[SP_Rock_Depth]),
       _color1(params[SP_Rock_R], params[SP_Rock_G], params[SP_Rock_B]),
       _color2(_color1.shiftUp(SHADE)),
       _color3(_color1.shiftDown(SHADE)),
-      _heightMult(params[SP_Rock_HeightMult])
+      _heightMult(params[SP_Rock_HeightMult]),
+      _random(seed)
 {
-    Init(_depth, glm::vec3(a[0], 0, a[1]), glm::vec3(b[0], 0, b[1]), glm::vec3(c[0], 0, c[1]));
+    Build(glm::vec3(a[0], 0, a[1]), glm::vec3(b[0], 0, b[1]), glm::vec3(c[0], 0, c[1]));
 }
 
-void RockObject::Init(int depth, glm::vec3 a, glm::vec3 b, glm::vec3 c)
+void RockObject::Build(glm::vec3 a, glm::vec3 b, glm::vec3 c)
+{
+    _keepHiddenFaces = keepHiddenFaces;
+    // Levels of detail stop recursing one and two levels earlier.
+    for (int i = 0; i < 2 && i < _depth; i++) {
+        mesh->lods.emplace_back();
+    }
+    for (int lod = 0; lod <= (int)mesh->lods.size(); lod++) {
+        Model &model = (lod == 0) ? mesh->model : mesh->lods[lod - 1];
+        if (_keepHiddenFaces) {
+            model.reserve(Model::Primitive::Tetra, tetraCount(_depth - lod));
+        } else {
+            model.reserve(Model::Primitive::Triangle, surfaceCount(_depth - lod));
+        }
+        // Tetras are only a few triangles each, too few to work out normals four at a time.
+        model.deferNormals();
+    }
+    Init(_depth, a, b, c);
+    bool optimize = optimizeMeshes;
+    for (int lod = 0; lod <= (int)mesh->lods.size(); lod++) {
+        Model &model = (lod == 0) ? mesh->model : mesh->lods[lod - 1];
+        model.fillNormals();
+        if (optimize) {
+            model.optimize();
+        }
+        // Rocks are only a couple of units across, so their positions fit in half floats.
+        model.setVertexFormat(VertexFormat::Compact);
+    }
+}
+
+size_t RockObject::tetraCount(int depth)
+{
+    size_t count = 0, level = 1;
+    for (int i = 0; i <= depth; i++) {
+        count += level;
+        level *= 3;
+    }
+    return count;
+}
+
+size_t RockObject::surfaceCount(int depth)
+{
+    size_t bottom = 1;
+    for (int i = 0; i < depth; i++) {
+        bottom *= 3;
+    }
+    return 3 * bottom + 1;
+}
+
+glm::vec3 RockObject::AddTetraOn(int depth, glm::vec3 a, glm::vec3 b, glm::vec3 c)
 {
     // Select a point slightly off the triangle.
     glm::vec3 finalPt = sampleInTri(a, b, c);
+    // Keep it above the ground. This only ever moves the top towards the triangle's plane, by
+    // no more than it was off it, so the tetra can't turn inside out. At worst it lies flat on
+    // the ground, on a face that faces down. Its faces still cover its neighbors' like any other.
     finalPt[1] = (finalPt[1] > 0) ? finalPt[1] : 0;
     // Add the tetra to the rock.
-    int best = rand() % 3;
+    int best = _random.below(3);
     Color *colorPtr;
     switch (best) {
         case 0:
@@ -52,8 +110,34 @@ void RockObject::Init(int depth, glm::vec3 a, glm::vec3 b, glm::vec3 c)
             break;
     }
     Color color = *colorPtr;
-    m.AddTetra(color, finalPt, a, b, c);
+    // Each model stops at a different depth; lod i has the tetras that are deeper than i.
+    for (int lod = 0; lod <= (int)mesh->lods.size(); lod++) {
+        Model &model = (lod == 0) ? mesh->model : mesh->lods[lod - 1];
+        if (depth < lod) {
+            continue;
+        }
+        if (_keepHiddenFaces) {
+            model.AddTetra(color, finalPt, a, b, c);
+            continue;
+        }
+        // A tetra's base is on a side of the one before it, and its sides get tetras built
+        // on them unless it's the last one down. The rock's surface is what's left: the base
+        // of the first tetra, and the sides of the last ones.
+        bool first = depth == _depth, last = depth == lod;
+        if (first && last) {
+            model.AddTetra(color, finalPt, a, b, c);
+        } else if (first) {
+            model.AddTetra(color, finalPt, a, b, c, Model::TetraFaces::Base);
+        } else if (last) {
+            model.AddTetra(color, finalPt, a, b, c, Model::TetraFaces::Sides);
+        }
+    }
+    return finalPt;
+}
 
+void RockObject::Init(int depth, glm::vec3 a, glm::vec3 b, glm::vec3 c)
+{
+    glm::vec3 finalPt = AddTetraOn(depth, a, b, c);
     if (depth == 0) {
         return;
     }
@@ -67,11 +151,11 @@ glm::vec3 RockObject::sampleInTri(glm::vec3 a, glm::vec3 b, glm::vec3 c)
 {
     float u, v;
     do {
-        u = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-        v = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
+        u = _random.uniform();
+        v = _random.uniform();
     } while (u + v > 1);
     glm::vec3 p = ((b - a) * u + (c - a) * v) + a;
-    float w = static_cast<float>(rand()) / static_cast<float>(RAND_MAX / _heightMult);
+    float w = _random.uniform() * _heightMult;
     glm::vec3 n = glm::cross((b - a), (c - a));
     float area = glm::length(n) / 2.0f;
 
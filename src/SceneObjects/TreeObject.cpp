@@ -1,9 +1,12 @@
 #include "SceneObjects/TreeObject.hpp"
+#include "Params/SceneParams.h"
 
 #define HALF_PI ((float)3.1415926 / 2.0f)
 
 using namespace ParamWorld;
 
+std::atomic<int> TreeObject::parallelLevels(3);
+
 TreeObject::TreeObject(glm::vec3 root, int depth, float height, float width, float scale,
                        float angle, Color leafColor, Color trunkColor, float leafSize)
     : SceneObject(ParamArray<SP_Count>(), root),
@@ -16,27 +19,253 @@ TreeObject::TreeObject(glm::vec3 root, int depth, float height, float width, flo
       _trunkColor(std::move(trunkColor)),
       _leafSize(leafSize)
 {
-    initModels(glm::vec3(0, 0, 0), glm::vec3(width, height, width), depth,
-               glm::fquat(1.0, 0.0, 0.0, 0.0));
-}
-
-void TreeObject::initModels(glm::vec3 root, glm::vec3 dims, int depth, glm::fquat rotation)
-{
-    if (depth == 0) {
-        // Add one cube, the leaf color. Dimensions should be all the width, I guess.
-        m.AddBoxFromCenter(_leafColor, root + glm::rotate(rotation, glm::vec3(0, dims.x, 0)),
-                           glm::vec3(dims[1] * 2, dims[0] * 2, dims[1] * 2), rotation);
-    } else {
-        glm::vec3 newZ = glm::rotate(rotation, glm::vec3(0, 0, 1));
-        glm::vec3 newY = glm::rotate(rotation, glm::vec3(0, 1, 0));
-        glm::vec3 center = root + glm::rotate(rotation, glm::vec3(0, dims[1] / 2.0f, 0));
-        m.AddBoxFromCenter(_trunkColor, center, dims, rotation);
-        glm::fquat left =
-            glm::angleAxis(_splitAngle, newZ) * glm::angleAxis(HALF_PI, newY) * rotation;
-        glm::fquat right =
-            glm::angleAxis(-_splitAngle, newZ) * glm::angleAxis(-HALF_PI, newY) * rotation;
-        glm::vec3 newRoot = root + glm::rotate(rotation, glm::vec3(0, dims[1], 0));
-        initModels(newRoot, dims * _scale, depth - 1, left);
-        initModels(newRoot, dims * _scale, depth - 1, right);
+    buildModels();
+}
+
+TreeObject::TreeObject(glm::vec3 root, ParamArray<SP_Count> params, MeshCache *cache)
+    : TreeObject(root, params, (cache != nullptr) ? quantizeShape(params) : params, cache)
+{
+}
+
+TreeObject::TreeObject(glm::vec3 root, ParamArray<SP_Count> params, ParamArray<SP_Count> shape,
+                       MeshCache *cache)
+    : SceneObject(params, root, Function::logistic(glfwGetTime() + 6.0, 1.0)),
+      _depth((int)shape[SP_Depth]),
+      _height(shape[SP_Height]),
+      _width(shape[SP_Width]),
+      _scale(shape[SP_Scale]),
+      _splitAngle(shape[SP_SplitAngle]),
+      _leafColor(shape[SP_LeafR], shape[SP_LeafG], shape[SP_LeafB]),
+      _trunkColor(shape[SP_BranchR], shape[SP_BranchG], shape[SP_BranchB]),
+      _leafSize(shape[SP_LeafSize])
+{
+    if (cache == nullptr) {
+        buildModels();
+        return;
+    }
+    MeshKey key;
+    quantizeShape(shape, &key);
+    mesh = cache->get(key, [this]() {
+        buildModels();
+        return mesh;
+    });
+}
+
+ParamArray<SP_Count> TreeObject::quantizeShape(ParamArray<SP_Count> params, MeshKey *key)
+{
+    // Steps are about a thirtieth of each param's range (see SceneParams), small enough that
+    // trees sharing a mesh are hard to tell apart.
+    static const std::pair<int, float> steps[] = {
+        {SP_Depth, 1.0f},        {SP_Width, 0.05f},       {SP_Height, 0.5f},
+        {SP_Scale, 0.025f},      {SP_SplitAngle, 0.025f}, {SP_BranchR, 1.0f / 32},
+        {SP_BranchG, 1.0f / 32}, {SP_BranchB, 1.0f / 32}, {SP_LeafR, 1.0f / 32},
+        {SP_LeafG, 1.0f / 32},   {SP_LeafB, 1.0f / 32},   {SP_LeafSize, 0.05f}};
+    MeshKey unused;
+    if (key == nullptr) {
+        key = &unused;
+    }
+    // Depth is cut down to a whole number of levels, like everywhere else.
+    params[SP_Depth] = (int)params[SP_Depth];
+    for (const auto &step : steps) {
+        const SParam &range = SceneParams::definition(step.first);
+        params[step.first] =
+            key->quantize(params[step.first], step.second, range.min, range.max);
+    }
+    return params;
+}
+
+struct TreeObject::LevelOrderVectors {
+    explicit LevelOrderVectors(size_t count) : fields(7 * count), slots(count) {}
+    LevelOrder nodes()
+    {
+        const size_t n = slots.size();
+        return {&fields[0], &fields[n],     &fields[2 * n],    &fields[3 * n],
+                &fields[4 * n], &fields[5 * n], &fields[6 * n], slots.data()};
+    }
+
+    std::vector<float> fields;
+    std::vector<uint32_t> slots;
+};
+
+void TreeObject::LevelOrder::set(size_t i, glm::vec3 root, glm::fquat rotation, uint32_t boxSlot)
+{
+    x[i] = root.x;
+    y[i] = root.y;
+    z[i] = root.z;
+    qw[i] = rotation.w;
+    qx[i] = rotation.x;
+    qy[i] = rotation.y;
+    qz[i] = rotation.z;
+    slot[i] = boxSlot;
+}
+
+void TreeObject::placeTree(const Level *levels, BoxInstance *out) const
+{
+    int split = std::min(std::max(parallelLevels.load(), 0), _depth);
+    int below = _depth - split;
+    LevelOrderVectors top(boxCount(split > 0 ? split : _depth));
+    LevelOrder nodes = top.nodes();
+    nodes.set(0, glm::vec3(0, 0, 0), glm::fquat(1.0, 0.0, 0.0, 0.0), 0);
+    if (split == 0) {
+        placeLevels(levels, _depth, _depth + 1, nodes, out);
+        return;
+    }
+
+    placeLevels(levels, _depth, split, nodes, out);
+    TaskPool::Group group;
+    const size_t first = (size_t(1) << split) - 1;
+    for (size_t i = first; i < 2 * first + 1; i++) {
+        glm::vec3 root(nodes.x[i], nodes.y[i], nodes.z[i]);
+        glm::fquat rotation(nodes.qw[i], nodes.qx[i], nodes.qy[i], nodes.qz[i]);
+        BoxInstance *subtree = out + nodes.slot[i];
+        auto place = [=] {
+            LevelOrderVectors storage(boxCount(below));
+            LevelOrder subtreeNodes = storage.nodes();
+            subtreeNodes.set(0, root, rotation, 0);
+            placeLevels(levels, below, below + 1, subtreeNodes, subtree);
+        };
+        if (i + 1 < 2 * first + 1) {
+            TaskPool::shared().submit(group, place);
+        } else {
+            place();
+        }
+    }
+    TaskPool::shared().wait(group);
+}
+
+void TreeObject::placeLevels(const Level *levels, int depth, int placedLevels, LevelOrder nodes,
+                             BoxInstance *out) const
+{
+    for (int k = 0; k < placedLevels && k <= depth; k++) {
+        const Level &level = levels[depth - k];
+        const size_t first = (size_t(1) << k) - 1, count = first + 1;
+        const BoxInstance shape = Model::MakeBoxInstance(
+            (k == depth) ? _leafColor : _trunkColor, glm::vec3(0, 0, 0), level.size,
+            glm::fquat(1.0, 0.0, 0.0, 0.0));
+        for (size_t i = first; i < first + count; i++) {
+            // A branch's box sits on its y axis, rotate(q, (0, 1, 0)).
+            float qw = nodes.qw[i], qx = nodes.qx[i], qy = nodes.qy[i], qz = nodes.qz[i];
+            float upX = 2 * (qx * qy - qw * qz);
+            float upY = 1 - 2 * (qx * qx + qz * qz);
+            float upZ = 2 * (qy * qz + qw * qx);
+            BoxInstance &box = out[nodes.slot[i]];
+            box.center = glm::vec3(nodes.x[i] + level.centerY * upX,
+                                   nodes.y[i] + level.centerY * upY,
+                                   nodes.z[i] + level.centerY * upZ);
+            box.size = shape.size;
+            box.rotation = glm::vec4(qx, qy, qz, qw);
+            box.color = shape.color;
+        }
+        if (k < depth) {
+            placeChildren(level, nodes.at(first), nodes.at(first + count),
+                          nodes.at(first + 2 * count), count, 1 + boxCount(depth - k - 1));
+        }
+    }
+}
+
+void TreeObject::placeChildren(const Level &level, LevelOrder from, LevelOrder left,
+                               LevelOrder right, size_t count, uint32_t rightSlot)
+{
+    // Plain float math on contiguous arrays, so the compiler can vectorize the loop.
+    const glm::fquat l = level.left, r = level.right;
+    for (size_t i = 0; i < count; i++) {
+        float qw = from.qw[i], qx = from.qx[i], qy = from.qy[i], qz = from.qz[i];
+        // Both children start up the branch's y axis.
+        float upX = 2 * (qx * qy - qw * qz);
+        float upY = 1 - 2 * (qx * qx + qz * qz);
+        float upZ = 2 * (qy * qz + qw * qx);
+        left.x[i] = right.x[i] = from.x[i] + level.childY * upX;
+        left.y[i] = right.y[i] = from.y[i] + level.childY * upY;
+        left.z[i] = right.z[i] = from.z[i] + level.childY * upZ;
+        // rotation * l and rotation * r.
+        left.qw[i] = qw * l.w - qx * l.x - qy * l.y - qz * l.z;
+        left.qx[i] = qw * l.x + qx * l.w + qy * l.z - qz * l.y;
+        left.qy[i] = qw * l.y - qx * l.z + qy * l.w + qz * l.x;
+        left.qz[i] = qw * l.z + qx * l.y - qy * l.x + qz * l.w;
+        right.qw[i] = qw * r.w - qx * r.x - qy * r.y - qz * r.z;
+        right.qx[i] = qw * r.x + qx * r.w + qy * r.z - qz * r.y;
+        right.qy[i] = qw * r.y - qx * r.z + qy * r.w + qz * r.x;
+        right.qz[i] = qw * r.z + qx * r.y - qy * r.x + qz * r.w;
+        left.slot[i] = from.slot[i] + 1;
+        right.slot[i] = from.slot[i] + rightSlot;
+    }
+}
+
+void TreeObject::buildModels()
+{
+    if (_depth < 0) {
+        _depth = 0;
+    }
+    std::vector<Level> levels(_depth + 1);
+    buildLevels(levels.data());
+    std::vector<BoxInstance> boxes(boxCount(_depth));
+    placeTree(levels.data(), boxes.data());
+    addModels(boxes.data(), boxes.size());
+}
+
+void TreeObject::addModels(const BoxInstance *boxes, size_t count)
+{
+    mesh->model.AddBoxInstances(boxes, count);
+
+    // Levels of detail: the top of the tree with the last 2 and then 4 levels of branches
+    // turned into blobs of leaves, and finally just the trunk and one blob.
+    mesh->lods.reserve(3);
+    for (int dropped : {2, 4}) {
+        if (dropped < _depth) {
+            mesh->lods.emplace_back();
+            mesh->lods.back().reserve(Model::Primitive::BoxInstance, boxCount(_depth - dropped));
+            addLodBoxes(boxes, _depth, dropped, mesh->lods.back());
+        }
+    }
+    if (_depth >= 1) {
+        mesh->lods.emplace_back();
+        BoxInstance trunkAndBlob[] = {boxes[0], leafBlob(&boxes[1], count - 1)};
+        mesh->lods.back().AddBoxInstances(trunkAndBlob, 2);
+    }
+}
+
+void TreeObject::addLodBoxes(const BoxInstance *boxes, int depth, int dropped, Model &lod) const
+{
+    if (depth <= dropped) {
+        BoxInstance blob = leafBlob(boxes, boxCount(depth));
+        lod.AddBoxInstances(&blob, 1);
+        return;
+    }
+    lod.AddBoxInstances(boxes, 1);
+    addLodBoxes(boxes + 1, depth - 1, dropped, lod);
+    addLodBoxes(boxes + 1 + boxCount(depth - 1), depth - 1, dropped, lod);
+}
+
+BoxInstance TreeObject::leafBlob(const BoxInstance *boxes, size_t count) const
+{
+    Bounds around;
+    for (size_t i = 0; i < count; i++) {
+        around.extend(Model::boundsOf(boxes[i]));
+    }
+    return Model::MakeBoxInstance(_leafColor, around.center(), around.max - around.min,
+                                  glm::fquat(1.0, 0.0, 0.0, 0.0));
+}
+
+void TreeObject::buildLevels(Level *levels) const
+{
+    // Children are turned the same way relative to their parent at every level.
+    const glm::fquat left = glm::angleAxis(_splitAngle, glm::vec3(0, 0, 1)) *
+                            glm::angleAxis(HALF_PI, glm::vec3(0, 1, 0));
+    const glm::fquat right = glm::angleAxis(-_splitAngle, glm::vec3(0, 0, 1)) *
+                             glm::angleAxis(-HALF_PI, glm::vec3(0, 1, 0));
+    glm::vec3 dims(_width, _height, _width);
+    for (int depth = _depth; depth >= 0; depth--, dims *= _scale) {
+        Level &level = levels[depth];
+        if (depth == 0) {
+            // One cube, the leaf color. Dimensions should be all the width, I guess.
+            level.centerY = dims.x;
+            level.size = glm::vec3(dims[1] * 2, dims[0] * 2, dims[1] * 2);
+        } else {
+            level.centerY = dims[1] / 2.0f;
+            level.size = dims;
+            level.childY = dims[1];
+            level.left = left;
+            level.right = right;
+        }
     }
 }
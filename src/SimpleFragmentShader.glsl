@@ -1,9 +1,10 @@
 #version 330 core
 
 in vec3 fragmentColor;
-out vec3 color;
+// Opaque, so that ImpostorAtlas can tell which parts of its pictures are covered.
+out vec4 color;
 
 // Runs on every fragment.
 void main() {
-  color = fragmentColor;
+  color = vec4(fragmentColor, 1.0);
 }
@@ -0,0 +1,132 @@
+#include "TaskPool.hpp"
+#include <algorithm>
+
+using namespace ParamWorld;
+
+namespace
+{
+// The queue that belongs to the current thread.
+thread_local size_t t_queueIndex = 0;
+// The pool that t_queueIndex belongs to, or nullptr outside of any pool's workers.
+thread_local const TaskPool *t_pool = nullptr;
+}
+
+TaskPool::TaskPool(unsigned workerCount) : _queued(0), _stopping(false), _waiters(0)
+{
+    if (workerCount == 0) {
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i <= workerCount; i++) {
+        _queues.emplace_back(new Queue());
+    }
+    for (unsigned i = 0; i < workerCount; i++) {
+        _workers.emplace_back(&TaskPool::work, this, i);
+    }
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    for (auto &worker : _workers) {
+        worker.join();
+    }
+}
+
+TaskPool &TaskPool::shared()
+{
+    static TaskPool pool;
+    return pool;
+}
+
+void TaskPool::submit(Group &group, std::function<void()> task)
+{
+    group._pending++;
+    // Workers keep their own tasks close, everyone else shares the last queue.
+    size_t index = (t_pool == this) ? t_queueIndex : _queues.size() - 1;
+    {
+        std::lock_guard<std::mutex> lock(_queues[index]->mutex);
+        _queues[index]->tasks.push_back({std::move(task), &group});
+    }
+    bool waiters;
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _queued++;
+        waiters = _waiters > 0;
+    }
+    _wake.notify_one();
+    // Threads blocked in wait() can help with it too.
+    if (waiters) {
+        _finished.notify_all();
+    }
+}
+
+void TaskPool::wait(Group &group)
+{
+    size_t home = (t_pool == this) ? t_queueIndex : _queues.size() - 1;
+    while (group._pending > 0) {
+        if (runOne(home)) {
+            continue;
+        }
+        // The group's last tasks are running elsewhere: sleep until they finish, or until
+        // there's more to help with.
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _waiters++;
+        _finished.wait(lock, [&] { return group._pending == 0 || _queued > 0; });
+        _waiters--;
+    }
+}
+
+bool TaskPool::runOne(size_t home)
+{
+    Task task;
+    bool found = false;
+    {
+        Queue &own = *_queues[home];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            found = true;
+        }
+    }
+    for (size_t i = 1; !found && i < _queues.size(); i++) {
+        Queue &other = *_queues[(home + i) % _queues.size()];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.tasks.empty()) {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            found = true;
+        }
+    }
+    if (!found) {
+        return false;
+    }
+    _queued--;
+    task.run();
+    // The group may be gone as soon as its count reaches 0, so it isn't touched after.
+    if (--task.group->_pending == 0) {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _finished.notify_all();
+    }
+    return true;
+}
+
+void TaskPool::work(size_t index)
+{
+    t_queueIndex = index;
+    t_pool = this;
+    while (true) {
+        if (runOne(index)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _wake.wait(lock, [this] { return _stopping || _queued > 0; });
+        if (_stopping && _queued == 0) {
+            return;
+        }
+    }
+}
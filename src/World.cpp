@@ -1,88 +1,313 @@
 #include "World.hpp"
+#include <algorithm>
 #include <iostream>
 
 using namespace ParamWorld;
 
-World::World(float worldExtent, GLuint matID)
-    : sceneParams(),
-      g(Ground(worldExtent)),
-      s(SkyObject(300, glm::vec3(0, 0, 0), 300.0f)),
-      MatrixID(matID)
+constexpr float Square::Size;
+
+namespace
+{
+// Separate streams of random numbers for each part of the world made from its seed.
+enum SeedStream : uint64_t { ParamsStream, SkyStream, SquaresStream };
+}
+
+World::World(float worldExtent, GLuint programID, GLuint instancedProgramID,
+             GLuint impostorProgramID, uint64_t seed)
+    : worldSeed(seed),
+      sceneParams(Random(seed).child(ParamsStream).next()),
+      g(worldExtent),
+      s(300, glm::vec3(0, 0, 0), 300.0f, Random(seed).child(SkyStream).next()),
+      // A picture for every mesh the cache can hold, since cached meshes share pictures.
+      atlas(instancedProgramID, generator.meshCache().capacity()),
+      ProgramID(programID),
+      MatrixID(glGetUniformLocation(programID, "MVP")),
+      InstancedProgramID(instancedProgramID),
+      InstancedMatrixID(glGetUniformLocation(instancedProgramID, "MVP")),
+      ImpostorProgramID(impostorProgramID)
 {
     g.init();
     s.init();
 }
 
+int World::lodFor(float distance) const
+{
+    if (distance > impostorDistance) {
+        return ChunkBatch::ImpostorLod;
+    }
+    // Past each of these distances, the next coarser level of detail is drawn.
+    static const float lodDistances[ChunkBatch::LodCount - 1] = {20.0f, 40.0f, 80.0f};
+    int lod = 0;
+    while (lod < ChunkBatch::LodCount - 1 && distance > lodDistances[lod]) {
+        lod++;
+    }
+    return lod;
+}
+
 void World::Render(glm::mat4 Perspective, glm::vec3 position, glm::vec3 direction, glm::vec3 up)
 {
     glm::mat4 View = glm::lookAt(position, position + direction, up);
-    for (auto &allObject : allObjects) {
-        glm::mat4 ModelM = allObject.calcModelMatrix();
-        glm::mat4 mvp = Perspective * View * ModelM;
-        glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &mvp[0][0]);
-        allObject.draw();
+    std::vector<ObjectHandle> grown;
+    growingObjects.update(glfwGetTime(), grown);
+    for (ObjectHandle handle : grown) {
+        // Done growing, so it can be drawn with the rest of its square from now on.
+        SceneObject &object = *allObjects.get(handle);
+        Square square = Square::containing(object.rootPosition);
+        ChunkBatch &chunk = chunks[square];
+        if (chunk.uploaded()) {
+            chunkUploads.push_back(square);
+        }
+        const std::shared_ptr<Mesh> &mesh = object.getMesh();
+        if (mesh->model.instanceCount() > 0 &&
+            impostorDistance < std::numeric_limits<float>::infinity()) {
+            // Objects sharing a mesh share its picture too.
+            int &index = mesh->impostor.index;
+            if (index < 0) {
+                mesh->impostor = atlas.add(mesh->model);
+                if (index >= 0) {
+                    impostorSlots.resize(std::max<size_t>(impostorSlots.size(), index + 1));
+                    impostorSlots[index].mesh = mesh;
+                    impostorSlots[index].used = true;
+                }
+            }
+            if (index >= 0) {
+                impostorSlots[index].chunkUses++;
+            }
+            chunk.Add(object, mesh->impostor);
+        } else {
+            chunk.Add(object);
+        }
+        object.releaseModel();
     }
+    UploadChunks();
     glm::mat4 stationaryView =
         glm::lookAt(glm::vec3(0, position[1], 0), glm::vec3(0, position[1], 0) + direction, up);
 
+    // Only draw what the camera can see, at a level of detail that fits how far away it is.
+    Frustum frustum(Perspective * View);
+    // Growing objects are kept by their index in growingObjects, for their model matrix.
+    std::vector<std::pair<size_t, int>> visibleObjects;
+    for (size_t i = 0; i < growingObjects.size(); i++) {
+        Bounds bounds = allObjects.get(growingObjects.handle(i))->worldBounds();
+        if (frustum.intersects(bounds)) {
+            visibleObjects.emplace_back(i, lodFor(bounds.distanceTo(position)));
+        }
+    }
+    std::vector<std::pair<ChunkBatch *, int>> visibleChunks;
+    for (auto &chunk : chunks) {
+        const Bounds &bounds = chunk.second.bounds();
+        if (frustum.intersects(bounds)) {
+            visibleChunks.emplace_back(&chunk.second, lodFor(bounds.distanceTo(position)));
+        }
+    }
+
+    // Triangle models first, then everything made of instanced boxes, so that the
+    // shader only changes once per frame.
+    glUseProgram(ProgramID);
+    // Compact models store positions relative to their origin, so that's added back first.
+    for (auto &visible : visibleObjects) {
+        SceneObject *object = allObjects.get(growingObjects.handle(visible.first));
+        glm::mat4 mvp = Perspective * View * growingObjects.modelMatrix(visible.first) *
+                        glm::translate(object->getModel(visible.second).origin());
+        glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &mvp[0][0]);
+        object->draw(visible.second);
+    }
+
+    glm::mat4 chunkMvp = Perspective * View;
+    for (auto &visible : visibleChunks) {
+        glm::mat4 mvp = chunkMvp * glm::translate(visible.first->origin());
+        glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &mvp[0][0]);
+        visible.first->Draw(visible.second);
+    }
+
     // draw ground
     glm::mat4 ModelM = g.calcModelMatrix();
     glm::mat4 mvp = Perspective * stationaryView * ModelM;
     glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &mvp[0][0]);
     g.draw();
 
+    glUseProgram(InstancedProgramID);
+    for (auto &visible : visibleObjects) {
+        glm::mat4 mvp = Perspective * View * growingObjects.modelMatrix(visible.first);
+        glUniformMatrix4fv(InstancedMatrixID, 1, GL_FALSE, &mvp[0][0]);
+        allObjects.get(growingObjects.handle(visible.first))->drawInstances(visible.second);
+    }
+
+    glUniformMatrix4fv(InstancedMatrixID, 1, GL_FALSE, &chunkMvp[0][0]);
+    for (auto &visible : visibleChunks) {
+        visible.first->DrawInstances(visible.second);
+    }
+
     // draw sky
     glm::mat4 mm = s.calcModelMatrix();
     glm::mat4 mmvp = Perspective * stationaryView * mm;
-    glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &mmvp[0][0]);
-    s.draw();
+    glUniformMatrix4fv(InstancedMatrixID, 1, GL_FALSE, &mmvp[0][0]);
+    s.drawInstances();
+
+    glUseProgram(ImpostorProgramID);
+    atlas.bind(ImpostorProgramID, chunkMvp, position);
+    for (auto &visible : visibleChunks) {
+        if (visible.second == ChunkBatch::ImpostorLod) {
+            visible.first->DrawImpostors();
+        }
+    }
 }
 
 void World::updateExploredSquares(GLFWwindow *window, glm::vec3 position, float horizontalAngle)
 {
-    Square square((int)position[0] / 5, (int)(position[2] / 5));
-    if (exploredSquares.find(square) == exploredSquares.end()) {
+    AddGeneratedThings();
+    UploadPending();
+    Square square = Square::containing(position);
+    if (lifetimes.explore(square)) {
         // A new square!
         AddMoreThings(position[0], position[2], horizontalAngle);
-        exploredSquares.insert(square);
         lastAdded = glfwGetTime();
     }
-    for (auto it = relevantObjects.begin(); it < relevantObjects.end(); /* nothing */) {
-        if (glm::length(it->rootPosition - position) < 2.0f) {
-            std::cout << "Learning object at " << it->rootPosition[0] << ", " << it->rootPosition[1]
-                      << ", " << it->rootPosition[2] << std::endl;
-            sceneParams.moveMeans(it->params, true);
-            it = relevantObjects.erase(it);
-        } else {
-            it++;
-        }
+    if (!(square == currentSquare)) {
+        currentSquare = square;
+        EvictFarSquares(position);
+    }
+    std::vector<ObjectHandle> learned;
+    relevantObjects.forEachNear(position, 2.0f,
+                                [&](ObjectHandle handle) { learned.push_back(handle); });
+    for (ObjectHandle handle : learned) {
+        const SceneObject &object = *allObjects.get(handle);
+        std::cout << "Learning object at " << object.rootPosition[0] << ", "
+                  << object.rootPosition[1] << ", " << object.rootPosition[2] << std::endl;
+        sceneParams.moveMeans(object.params, true);
+        relevantObjects.remove(object.rootPosition, handle);
+        lifetimes.learn(object.rootPosition, handle);
     }
 }
 
 void World::AddMoreThings(float x, float z, float horizontalAngle)
 {
     glm::vec3 dirFacing(sin(horizontalAngle), 0, cos(horizontalAngle));
-    int newThings = rand() % 3;
+    // Everything new in a square comes from that square's own stream, and each object's
+    // from its own stream in that, so nothing depends on what was made before.
+    Square square = Square::containing(glm::vec3(x, 0, z));
+    Random squareRandom = Random(worldSeed).child(SquaresStream).child(square.x).child(square.z);
+    int newThings = squareRandom.below(3);
     for (int i = 0; i < newThings; i++) {
-        float theta =
-            ((static_cast<float>(rand()) / static_cast<float>(RAND_MAX)) * MATH_FLOAT_PI * .7f) -
-            (MATH_FLOAT_PI * .35f);
+        Random random = squareRandom.child(i);
+        float theta = (random.uniform() * MATH_FLOAT_PI * .7f) - (MATH_FLOAT_PI * .35f);
         glm::vec3 rootPos =
             glm::vec3(x, 0, z) +
             glm::rotate(glm::angleAxis(theta, glm::vec3(0, 1, 0)), dirFacing * radius);
-        if ((rand() % 2) == 0) {
-            TreeObject tree(rootPos, sceneParams.generate(2.0f));
-            tree.init();
-            allObjects.push_back(tree);
-            // TODO: add support for 'growing' models.
-            relevantObjects.push_back(tree);
-        } else {
-            RockObject rock(rootPos, glm::vec2(1.0f, 0), glm::vec2(-0.5f, -.5f),
-                            glm::vec2(-0.5f, 0.5f), sceneParams.generate(2.0f));
-            rock.init();
-            allObjects.push_back(rock);
-            // TODO: deal with growing models here
-            relevantObjects.push_back(rock);
+        GenerationJob job;
+        job.kind = (random.below(2) == 0) ? GenerationJob::Tree : GenerationJob::Rock;
+        job.rootPosition = rootPos;
+        job.params = sceneParams.generate(2.0f, random);
+        job.seed = random.next();
+        lifetimes.addJob(job);
+        generator.push(job);
+    }
+}
+
+void World::AddGeneratedThings()
+{
+    std::vector<GeneratedObject> generated;
+    generator.collect(generated);
+    for (auto &finished : generated) {
+        // Moved into the store, so the geometry is never copied.
+        ObjectHandle handle = allObjects.add(std::move(finished.object));
+        if (!lifetimes.addObject(finished.job, handle)) {
+            // Its square was evicted while it was being built.
+            allObjects.remove(handle);
+            continue;
+        }
+        allObjects.get(handle)->beginUpload();
+        uploadQueue.push_back(handle);
+    }
+}
+
+void World::UploadPending()
+{
+    generator.meshCache().freeRetired();
+    budgetLeft = uploadBudget;
+    // Chunks go first, since they only have something to send after objects finish growing.
+    UploadChunks();
+    while (!uploadQueue.empty() && budgetLeft > 0) {
+        ObjectHandle handle = uploadQueue.front();
+        SceneObject &object = *allObjects.get(handle);
+        budgetLeft -= object.uploadSome(budgetLeft);
+        if (!object.isUploaded()) {
+            break;
+        }
+        uploadQueue.pop_front();
+        growingObjects.add(handle, object.growth(), object.rootPosition);
+        // Rebuilt objects the player already learned from don't teach the params again.
+        if (!lifetimes.learned(object.rootPosition, handle)) {
+            relevantObjects.insert(object.rootPosition, handle);
+        }
+    }
+}
+
+void World::UploadChunks()
+{
+    while (!chunkUploads.empty() && budgetLeft > 0) {
+        auto chunk = chunks.find(chunkUploads.front());
+        if (chunk != chunks.end()) {
+            budgetLeft -= chunk->second.uploadSome(budgetLeft);
+            if (!chunk->second.uploaded()) {
+                break;
+            }
+        }
+        // Done, or evicted before it was.
+        chunkUploads.pop_front();
+    }
+}
+
+void World::EvictFarSquares(glm::vec3 position)
+{
+    std::vector<Square> squares;
+    std::vector<ObjectHandle> objects;
+    std::vector<GenerationJob> jobs;
+    lifetimes.update(position, squares, objects, jobs);
+    for (const GenerationJob &job : jobs) {
+        generator.push(job);
+    }
+    if (squares.empty()) {
+        return;
+    }
+
+    for (ObjectHandle handle : objects) {
+        SceneObject *object = allObjects.get(handle);
+        if (object != nullptr) {
+            relevantObjects.remove(object->rootPosition, handle);
+            allObjects.remove(handle);
+        }
+    }
+    // Removed objects don't have anything in the store any more.
+    auto removed = [this](ObjectHandle handle) { return allObjects.get(handle) == nullptr; };
+    growingObjects.removeIf(removed);
+    uploadQueue.erase(std::remove_if(uploadQueue.begin(), uploadQueue.end(), removed),
+                      uploadQueue.end());
+
+    for (const Square &square : squares) {
+        auto chunk = chunks.find(square);
+        if (chunk == chunks.end()) {
+            continue;
+        }
+        for (const ImpostorInstance &impostor : chunk->second.impostors()) {
+            impostorSlots[impostor.index].chunkUses--;
+        }
+        chunks.erase(chunk);
+    }
+    ReleaseUnusedImpostors();
+}
+
+void World::ReleaseUnusedImpostors()
+{
+    for (size_t i = 0; i < impostorSlots.size(); i++) {
+        ImpostorSlot &slot = impostorSlots[i];
+        if (slot.used && slot.chunkUses == 0) {
+            // A mesh that's still cached takes a new picture if it's baked again.
+            if (std::shared_ptr<Mesh> mesh = slot.mesh.lock()) {
+                mesh->impostor.index = -1;
+            }
+            atlas.release(i);
+            slot = ImpostorSlot();
         }
     }
 }
@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <ctime>
 #include <sstream>
 #include <map>
+#include <memory>
 #include <string>
 
 #define GLEW_STATIC  // Depending on how you built/installed GLEW, you may want to change this
@@ -216,16 +218,20 @@ int main()
     glDepthFunc(GL_LESS);
 
     GLuint programID = LoadShaders("SimpleVertexShader.glsl", "SimpleFragmentShader.glsl");
+    GLuint instancedID = LoadShaders("InstancedVertexShader.glsl", "SimpleFragmentShader.glsl");
+    GLuint impostorID = LoadShaders("ImpostorVertexShader.glsl", "ImpostorFragmentShader.glsl");
     // Shaders for fonts.
     GLuint fontID = LoadShaders("FontVertexShader.glsl", "FontFragmentShader.glsl");
 
-    GLuint MatrixID = glGetUniformLocation(programID, "MVP");
-
     GLuint VertexArrayID;
     glGenVertexArrays(1, &VertexArrayID);
     glBindVertexArray(VertexArrayID);
 
-    World w(299.0, MatrixID);
+    // On the heap so that it (and its GL buffers and worker threads) can be cleaned up
+    // before GLFW is.
+    std::unique_ptr<World> world(
+        new World(299.0, programID, instancedID, impostorID, time(nullptr)));
+    World &w = *world;
 
     Player player(glm::vec3(0, 1.7, 0));
 
@@ -256,6 +262,9 @@ int main()
         w.Render(player.getProjectionMatrix(), player.getPosition(), player.getDirection(),
                  player.getUp());
 
+        // Models bind their own vertex arrays, so go back to the shared one for text.
+        glBindVertexArray(VertexArrayID);
+
         // Render Text.
         // TODO: follow OpenGL_programming: Modern_OpenGL_Tutorial_Text_Rendering front to back when you have time.
         int width, height;
@@ -315,7 +324,9 @@ int main()
     while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && glfwWindowShouldClose(window) == 0);
 
     // Close OpenGL window and terminate GLFW
+    world.reset();
     glDeleteProgram(programID);
+    glDeleteProgram(instancedID);
     glfwTerminate();
     return 0;
 }
@@ -0,0 +1,193 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include "SceneObjects/MeshOptimizer.hpp"
+#include "SceneObjects/RockObject.hpp"
+#include "SceneObjects/TreeObject.hpp"
+#include "catch.hpp"
+
+using namespace ParamWorld;
+
+namespace
+{
+// Heap allocations made by the current thread, counted by the operator new below.
+thread_local size_t allocations = 0;
+
+Color leaf(0.1f, 0.8f, 0.2f), trunk(0.4f, 0.3f, 0.1f), stone(0.5f, 0.5f, 0.5f);
+
+size_t treeAllocations(int depth)
+{
+    size_t before = allocations;
+    TreeObject tree(glm::vec3(0, 0, 0), depth, 1.0f, 0.2f, 0.75f, 0.6f, leaf, trunk, 0.3f);
+    return allocations - before;
+}
+
+size_t rockAllocations(int depth)
+{
+    size_t before = allocations;
+    RockObject rock(depth, stone, glm::vec3(0, 0, 0), glm::vec2(1, 0), glm::vec2(-0.5f, -0.5f),
+                    glm::vec2(-0.5f, 0.5f), 1.0f);
+    return allocations - before;
+}
+}
+
+void *operator new(size_t size)
+{
+    allocations++;
+    void *p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+TEST_CASE("Building objects allocates the same amount once they have every level of detail",
+          "[Model]")
+{
+    // Branches handed to the task pool allocate their tasks, so build on this thread only.
+    // Shallow objects have fewer levels of detail, so start from depths that have them all.
+    TreeObject::setParallelLevels(0);
+    size_t smallTree = treeAllocations(5);
+    for (int depth = 6; depth <= 8; depth++) {
+        REQUIRE(treeAllocations(depth) == smallTree);
+    }
+    TreeObject::setParallelLevels(3);
+
+    size_t smallRock = rockAllocations(2);
+    for (int depth = 3; depth <= 5; depth++) {
+        REQUIRE(rockAllocations(depth) == smallRock);
+    }
+
+    // Besides what the tree keeps (its mesh, the list of levels of detail, and one array of
+    // boxes per model), building one only allocates four arrays of scratch space: the levels,
+    // the boxes, and the two that the branches are placed from.
+    TreeObject::setParallelLevels(0);
+    for (int depth = 0; depth <= 10; depth++) {
+        size_t before = allocations;
+        TreeObject tree(glm::vec3(0, 0, 0), depth, 1.0f, 0.2f, 0.75f, 0.6f, leaf, trunk, 0.3f);
+        size_t added = allocations - before;
+        REQUIRE(added == 6 + size_t(tree.lodCount()));
+    }
+    TreeObject::setParallelLevels(3);
+
+    // Compact models pack shapes straight into their own arrays.
+    Model compact;
+    compact.setVertexFormat(VertexFormat::Compact);
+    // Room for a third box covers the tetra.
+    compact.reserve(Model::Primitive::Box, 3);
+    size_t before = allocations;
+    compact.AddBoxFromCenter(stone, glm::vec3(0, 0, 0), glm::vec3(1, 1, 1));
+    compact.AddBoxFromCenter(stone, glm::vec3(0, 1, 0), glm::vec3(1, 2, 1),
+                             glm::angleAxis(0.5f, glm::vec3(0, 1, 0)));
+    compact.AddTetra(stone, glm::vec3(0, 1, 0), glm::vec3(1, 0, 0), glm::vec3(0, 0, 1),
+                     glm::vec3(-1, 0, 0));
+    // Read before REQUIRE, which allocates.
+    size_t added = allocations - before;
+    REQUIRE(added == 0);
+}
+
+TEST_CASE("Benchmark building trees and rocks", "[.][benchmark]")
+{
+    typedef std::chrono::steady_clock Clock;
+    const int runs = 50;
+    std::cout << "depth  tree allocs  tree us  rock allocs   rock us" << std::endl;
+    for (int depth = 1; depth <= 6; depth++) {
+        Clock::time_point start = Clock::now();
+        size_t treeAllocs = 0;
+        for (int i = 0; i < runs; i++) {
+            treeAllocs += treeAllocations(depth);
+        }
+        Clock::time_point middle = Clock::now();
+        size_t rockAllocs = 0;
+        for (int i = 0; i < runs; i++) {
+            rockAllocs += rockAllocations(depth);
+        }
+        Clock::time_point end = Clock::now();
+        auto micros = [&](Clock::duration d) {
+            return std::chrono::duration_cast<std::chrono::microseconds>(d).count() / runs;
+        };
+        std::cout << std::setw(5) << depth << std::setw(13) << treeAllocs / runs << std::setw(9)
+                  << micros(middle - start) << std::setw(13) << rockAllocs / runs
+                  << std::setw(10) << micros(end - middle) << std::endl;
+    }
+}
+
+TEST_CASE("Benchmark spawning trees with a mesh cache", "[.][benchmark]")
+{
+    typedef std::chrono::steady_clock Clock;
+    const int runs = 200;
+    ParamArray<SP_Count> params(0.5f);
+    params[SP_Depth] = 7;
+    params[SP_Height] = 2.0f;
+    MeshCache cache;
+    for (bool warm : {false, true}) {
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < runs; i++) {
+            TreeObject tree(glm::vec3(0, 0, 0), params, warm ? &cache : nullptr);
+        }
+        std::chrono::duration<double, std::micro> micros = Clock::now() - start;
+        std::cout << (warm ? "warm cache: " : "no cache:   ") << micros.count() / runs
+                  << " us per depth 7 tree" << std::endl;
+    }
+}
+
+TEST_CASE("Benchmark optimizing meshes for the vertex cache", "[.][benchmark]")
+{
+    typedef std::chrono::steady_clock Clock;
+    const int runs = 50;
+    auto acmr = [](const Model &model) {
+        return averageCacheMissRatio(model.indices().data(), model.indexCount(),
+                                     model.vertexCount());
+    };
+    // ACMR is vertices transformed per triangle with a 16 vertex FIFO cache; flat shaded
+    // triangles that share no vertices can't do better than 3.
+    std::cout << "            vertices   optimized  ACMR  optimized  build us  optimized"
+              << std::endl;
+    for (int depth = 2; depth <= 6; depth++) {
+        size_t vertices[2];
+        float misses[2];
+        double micros[2];
+        for (bool optimize : {false, true}) {
+            RockObject::setOptimizeMeshes(optimize);
+            Clock::time_point start = Clock::now();
+            for (int i = 0; i < runs; i++) {
+                rockAllocations(depth);
+            }
+            std::chrono::duration<double, std::micro> spent = Clock::now() - start;
+            micros[optimize] = spent.count() / runs;
+            RockObject rock(depth, stone, glm::vec3(0, 0, 0), glm::vec2(1, 0),
+                            glm::vec2(-0.5f, -0.5f), glm::vec2(-0.5f, 0.5f), 1.0f);
+            vertices[optimize] = rock.getModel().vertexCount();
+            misses[optimize] = acmr(rock.getModel());
+        }
+        std::cout << "rock depth " << depth << std::setw(10) << vertices[0] << std::setw(12)
+                  << vertices[1] << std::setw(6) << int(misses[0] * 100) / 100.0
+                  << std::setw(11) << int(misses[1] * 100) / 100.0 << std::setw(10)
+                  << int(micros[0]) << std::setw(11) << int(micros[1]) << std::endl;
+    }
+    RockObject::setOptimizeMeshes(true);
+
+    // Flush boxes of one color, whose coplanar faces do share corners once welded.
+    Model grid;
+    for (int x = 0; x < 16; x++) {
+        for (int z = 0; z < 16; z++) {
+            grid.AddBoxFromCorner(stone, glm::vec3(x, 0, z), glm::vec3(1, 1, 1));
+        }
+    }
+    size_t vertices = grid.vertexCount();
+    float misses = acmr(grid);
+    Clock::time_point start = Clock::now();
+    grid.optimize();
+    std::chrono::duration<double, std::micro> spent = Clock::now() - start;
+    std::cout << "16x16 boxes " << std::setw(9) << vertices << std::setw(12)
+              << grid.vertexCount() << std::setw(6) << int(misses * 100) / 100.0 << std::setw(11)
+              << int(acmr(grid) * 100) / 100.0 << std::setw(21) << int(spent.count())
+              << std::endl;
+}
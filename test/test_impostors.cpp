@@ -0,0 +1,210 @@
+#include <chrono>
+#include "ChunkBatch.hpp"
+#include "ImpostorAtlas.hpp"
+#include "SceneObjects/MeshCache.hpp"
+#include "SceneObjects/TreeObject.hpp"
+#include "catch.hpp"
+#include "shader.hpp"
+
+using namespace ParamWorld;
+
+// These need an OpenGL 3.3 context, so they're hidden. Run them with `UnitTests [gl]`; without
+// a display, `LIBGL_ALWAYS_SOFTWARE=1 xvfb-run UnitTests [gl]` uses Mesa's software renderer.
+
+namespace
+{
+const int FrameSize = 256;
+
+struct Frame {
+    GLuint primitives;
+    double milliseconds;
+    size_t coveredPixels;
+};
+
+// Draws a frame several times into the bound framebuffer, and measures the last one.
+template <typename DrawFunc>
+Frame measure(DrawFunc draw)
+{
+    const int repeats = 5;
+    Frame frame;
+    GLuint query;
+    glGenQueries(1, &query);
+    glFinish();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i++) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glBeginQuery(GL_PRIMITIVES_GENERATED, query);
+        draw();
+        glEndQuery(GL_PRIMITIVES_GENERATED);
+        glFinish();
+    }
+    auto end = std::chrono::steady_clock::now();
+    frame.milliseconds = std::chrono::duration<double, std::milli>(end - start).count() / repeats;
+    glGetQueryObjectuiv(query, GL_QUERY_RESULT, &frame.primitives);
+    glDeleteQueries(1, &query);
+
+    std::vector<unsigned char> pixels(FrameSize * FrameSize * 4);
+    glReadPixels(0, 0, FrameSize, FrameSize, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    frame.coveredPixels = 0;
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+        frame.coveredPixels += (pixels[i] | pixels[i + 1] | pixels[i + 2]) != 0;
+    }
+    return frame;
+}
+}
+
+TEST_CASE("Far away trees are cheaper to draw as impostors", "[.][gl]")
+{
+    if (!glfwInit()) {
+        WARN("Couldn't start GLFW, skipping.");
+        return;
+    }
+    glfwWindowHint(GLFW_VISIBLE, 0);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, 1);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    GLFWwindow *window = glfwCreateWindow(FrameSize, FrameSize, "Impostors", nullptr, nullptr);
+    if (window == nullptr) {
+        WARN("Couldn't make an OpenGL 3.3 context, skipping.");
+        glfwTerminate();
+        return;
+    }
+    glfwMakeContextCurrent(window);
+    glewExperimental = 1u;
+    REQUIRE(glewInit() == GLEW_OK);
+
+    GLuint instancedID = LoadShaders(SHADER_DIR "InstancedVertexShader.glsl",
+                                     SHADER_DIR "SimpleFragmentShader.glsl");
+    GLuint impostorID = LoadShaders(SHADER_DIR "ImpostorVertexShader.glsl",
+                                    SHADER_DIR "ImpostorFragmentShader.glsl");
+    REQUIRE(instancedID != 0);
+    REQUIRE(impostorID != 0);
+    {
+        // Draw somewhere that's the same size everywhere, instead of the hidden window.
+        GLuint framebuffer, color, depth;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glGenRenderbuffers(1, &color);
+        glBindRenderbuffer(GL_RENDERBUFFER, color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, FrameSize, FrameSize);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, FrameSize, FrameSize);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        REQUIRE(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+        glViewport(0, 0, FrameSize, FrameSize);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+        ImpostorAtlas atlas(instancedID);
+        // One picture for every mesh the cache can keep.
+        REQUIRE(atlas.capacity() == MeshCache().capacity());
+        TreeObject tree(glm::vec3(0, 0, 0), 8, 1.0f, 0.2f, 0.75f, 0.6f,
+                        Color(0.1f, 0.8f, 0.2f), Color(0.4f, 0.3f, 0.1f), 0.3f);
+        tree.init();
+        ImpostorInstance picture = atlas.add(tree.getModel());
+        REQUIRE(picture.index == 0);
+
+        // A field of the same tree, far enough away that each is only a few pixels wide.
+        const int side = 10;
+        float spacing = 2.0f * picture.radius;
+        ChunkBatch asGeometry, asImpostors;
+        for (int x = 0; x < side; x++) {
+            for (int z = 0; z < side; z++) {
+                tree.rootPosition = glm::vec3(x * spacing, 0, -z * spacing);
+                asGeometry.Add(tree);
+                asImpostors.Add(tree, picture);
+            }
+        }
+        glm::vec3 target(side * spacing * 0.5f, picture.center.y, -side * spacing * 0.5f);
+        // Impostors are pictures from the side, which is how the player sees far away trees.
+        glm::vec3 eye = target + glm::vec3(0, picture.radius, side * spacing * 1.5f);
+        glm::mat4 viewProjection = glm::perspective(0.8f, 1.0f, 0.1f, 1000.0f) *
+                                   glm::lookAt(eye, target, glm::vec3(0, 1, 0));
+
+        // Uploads the chunk; the trees have no plain triangles at full detail to draw.
+        asGeometry.uploadSome(SIZE_MAX);
+        asGeometry.Draw();
+        Frame geometry = measure([&]() {
+            glUseProgram(instancedID);
+            glUniformMatrix4fv(glGetUniformLocation(instancedID, "MVP"), 1, GL_FALSE,
+                               &viewProjection[0][0]);
+            asGeometry.DrawInstances();
+        });
+        Frame impostors = measure([&]() {
+            glUseProgram(impostorID);
+            atlas.bind(impostorID, viewProjection, eye);
+            asImpostors.DrawImpostors();
+        });
+        INFO("Geometry: " << geometry.primitives << " primitives, " << geometry.milliseconds
+                          << " ms, " << geometry.coveredPixels << " pixels");
+        INFO("Impostors: " << impostors.primitives << " primitives, " << impostors.milliseconds
+                           << " ms, " << impostors.coveredPixels << " pixels");
+
+        // Two triangles a tree instead of 12 per box.
+        REQUIRE(impostors.primitives == 2 * side * side);
+        REQUIRE(impostors.primitives * 100 < geometry.primitives);
+        REQUIRE(impostors.milliseconds < geometry.milliseconds);
+        // And they look about as big.
+        REQUIRE(geometry.coveredPixels > 0);
+        REQUIRE(impostors.coveredPixels == Approx(geometry.coveredPixels).epsilon(0.3));
+
+        // Adding to a chunk that's on the GPU only sends the new tree, a frame's budget at a
+        // time, and draws what has arrived in the meantime.
+        ChunkBatch growing;
+        glm::vec3 between(spacing * 0.5f, picture.center.y, 0);
+        glm::mat4 closeUp = glm::perspective(0.8f, 1.0f, 0.1f, 1000.0f) *
+                            glm::lookAt(between + glm::vec3(0, 0, 3 * spacing), between,
+                                        glm::vec3(0, 1, 0));
+        tree.rootPosition = glm::vec3(0, 0, 0);
+        growing.Add(tree);
+        size_t oneTree = growing.uploadSome(SIZE_MAX);
+        REQUIRE(growing.uploaded());
+        auto drawGrowing = [&]() {
+            glUseProgram(instancedID);
+            glUniformMatrix4fv(glGetUniformLocation(instancedID, "MVP"), 1, GL_FALSE,
+                               &closeUp[0][0]);
+            growing.DrawInstances();
+        };
+        GLuint onePrimitives = measure(drawGrowing).primitives;
+        tree.rootPosition = glm::vec3(spacing, 0, 0);
+        growing.Add(tree);
+        REQUIRE_FALSE(growing.uploaded());
+        REQUIRE(measure(drawGrowing).primitives == onePrimitives);
+        size_t sent = 0, frames = 0;
+        while (!growing.uploaded()) {
+            size_t frame = growing.uploadSome(oneTree / 4);
+            REQUIRE(frame <= oneTree / 4);
+            sent += frame;
+            frames++;
+        }
+        REQUIRE(sent == oneTree);
+        REQUIRE(frames >= 4);
+        Frame appended = measure(drawGrowing);
+        REQUIRE(appended.primitives == 2 * onePrimitives);
+        // Looks the same as both trees uploaded at once.
+        ChunkBatch atOnce;
+        tree.rootPosition = glm::vec3(0, 0, 0);
+        atOnce.Add(tree);
+        tree.rootPosition = glm::vec3(spacing, 0, 0);
+        atOnce.Add(tree);
+        atOnce.uploadSome(SIZE_MAX);
+        Frame whole = measure([&]() {
+            glUseProgram(instancedID);
+            glUniformMatrix4fv(glGetUniformLocation(instancedID, "MVP"), 1, GL_FALSE,
+                               &closeUp[0][0]);
+            atOnce.DrawInstances();
+        });
+        REQUIRE(appended.coveredPixels > 0);
+        REQUIRE(appended.coveredPixels == whole.coveredPixels);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &color);
+        glDeleteRenderbuffers(1, &depth);
+    }
+    glfwTerminate();
+}
@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <array>
+#include "SceneObjects/FaceNormals.hpp"
+#include "SceneObjects/MeshOptimizer.hpp"
+#include "SceneObjects/Model.hpp"
+#include "catch.hpp"
+
+using namespace ParamWorld;
+
+TEST_CASE("Models store indexed, deduplicated vertices", "[Model]")
+{
+    Model m;
+    Color c(0.5f, 0.25f, 1.0f);
+
+    SECTION("a box is 24 vertices and 36 indices")
+    {
+        m.AddBoxFromCenter(c, glm::vec3(0, 0, 0), glm::vec3(1, 2, 3));
+        REQUIRE(m.vertexCount() == 24);
+        REQUIRE(m.indexCount() == 36);
+    }
+
+    SECTION("a rotated box is 24 vertices and 36 indices")
+    {
+        m.AddBoxFromCenter(c, glm::vec3(1, 1, 1), glm::vec3(1, 2, 3),
+                           glm::angleAxis(0.3f, glm::vec3(0, 0, 1)));
+        REQUIRE(m.vertexCount() == 24);
+        REQUIRE(m.indexCount() == 36);
+    }
+
+    SECTION("a tetra is 12 vertices and 12 indices")
+    {
+        m.AddTetra(c, glm::vec3(0, 1, 0), glm::vec3(1, 0, 0), glm::vec3(-1, 0, -1),
+                   glm::vec3(-1, 0, 1));
+        REQUIRE(m.vertexCount() == 12);
+        REQUIRE(m.indexCount() == 12);
+    }
+
+    SECTION("indices of later primitives are offset past earlier vertices")
+    {
+        m.AddBoxFromCorner(c, glm::vec3(0, 0, 0), glm::vec3(1, 1, 1));
+        m.AddBoxFromCorner(c, glm::vec3(2, 0, 0), glm::vec3(1, 1, 1));
+        for (size_t i = 36; i < m.indexCount(); i++) {
+            REQUIRE(m.indices()[i] >= 24);
+            REQUIRE(m.indices()[i] < 48);
+        }
+    }
+
+    SECTION("box faces are wound and lit facing outward")
+    {
+        m.AddBoxFromCenter(c, glm::vec3(0, 0, 0), glm::vec3(1, 1, 1));
+        for (size_t i = 0; i < m.indexCount(); i += 3) {
+            glm::vec3 a = m.vertices()[m.indices()[i]].position;
+            glm::vec3 b = m.vertices()[m.indices()[i + 1]].position;
+            glm::vec3 d = m.vertices()[m.indices()[i + 2]].position;
+            glm::vec3 n = glm::cross(b - a, d - a);
+            REQUIRE(glm::dot(n, a) > 0.0f);
+            glm::vec3 packed(glm::unpackSnorm3x10_1x2(m.vertices()[m.indices()[i]].normal));
+            REQUIRE(glm::dot(packed, a) > 0.0f);
+        }
+    }
+
+    SECTION("tetra faces are wound and lit facing outward either way up")
+    {
+        glm::vec3 l(1, 0, 0), r(-0.5f, 0, -0.5f), b(-0.5f, 0, 0.5f);
+        m.AddTetra(c, glm::vec3(0, 1, 0), l, r, b);
+        m.AddTetra(c, glm::vec3(0, -1, 0), l, r, b);
+        for (size_t i = 0; i < m.indexCount(); i += 3) {
+            glm::vec3 inside = glm::vec3(0, (i < 12) ? 0.25f : -0.25f, 0);
+            glm::vec3 a = m.vertices()[m.indices()[i]].position;
+            glm::vec3 e = m.vertices()[m.indices()[i + 1]].position;
+            glm::vec3 d = m.vertices()[m.indices()[i + 2]].position;
+            glm::vec3 n = glm::cross(e - a, d - a);
+            REQUIRE(glm::dot(n, a - inside) > 0.0f);
+            glm::vec3 packed(glm::unpackSnorm3x10_1x2(m.vertices()[m.indices()[i]].normal));
+            REQUIRE(glm::dot(packed, a - inside) > 0.0f);
+        }
+    }
+}
+
+TEST_CASE("Compact models keep their geometry in 12 byte vertices", "[Model]")
+{
+    REQUIRE(sizeof(CompactVertex) == 12);
+
+    Model full, compact;
+    Color c(0.5f, 0.25f, 1.0f);
+    glm::fquat turn = glm::angleAxis(0.7f, glm::normalize(glm::vec3(1, 2, 3)));
+    for (Model *m : {&full, &compact}) {
+        m->AddBoxFromCenter(c, glm::vec3(101, 2, -53), glm::vec3(1, 2, 3), turn);
+        m->AddTetra(c, glm::vec3(100, 3, -50), glm::vec3(101, 0, -50), glm::vec3(99, 0, -51),
+                    glm::vec3(99, 0, -49));
+    }
+    compact.setVertexFormat(VertexFormat::Compact, glm::vec3(100, 0, -50));
+
+    REQUIRE(compact.vertexCount() == full.vertexCount());
+    REQUIRE(compact.vertices().empty());
+    REQUIRE(compact.compactVertices().size() == full.vertexCount());
+    REQUIRE(compact.indices() == full.indices());
+    REQUIRE(compact.uploadSize() < full.uploadSize());
+
+    auto requireClose = [](const Model &a, const Model &b) {
+        for (size_t i = 0; i < a.vertexCount(); i++) {
+            Vertex v = a.vertex(i), w = b.vertex(i);
+            // Half floats have 11 bits of precision, so a few units out that's about 1/500.
+            REQUIRE(glm::length(v.position - w.position) < 0.005f);
+            glm::vec3 n(glm::unpackSnorm3x10_1x2(v.normal)), m(glm::unpackSnorm3x10_1x2(w.normal));
+            REQUIRE(glm::dot(glm::normalize(n), glm::normalize(m)) > 0.999f);
+            REQUIRE(v.color == w.color);
+        }
+    };
+    requireClose(compact, full);
+
+    SECTION("shapes added later are packed too")
+    {
+        for (Model *m : {&full, &compact}) {
+            m->AddBoxFromCorner(c, glm::vec3(100, 0, -50), glm::vec3(1, 1, 1));
+            // Upside down, so its faces are flipped.
+            m->AddTetra(c, glm::vec3(100, -3, -50), glm::vec3(101, 0, -50),
+                        glm::vec3(99, 0, -51), glm::vec3(99, 0, -49), Model::TetraFaces::Sides);
+        }
+        REQUIRE(compact.compactVertices().size() == full.vertexCount());
+        REQUIRE(compact.indices() == full.indices());
+        requireClose(compact, full);
+    }
+
+    SECTION("compact models can be baked into other compact models")
+    {
+        Model batch, fullBatch;
+        batch.setVertexFormat(VertexFormat::Compact, glm::vec3(105, 0, -50));
+        batch.Append(compact, glm::translate(glm::vec3(5, 0, 0)));
+        fullBatch.Append(full, glm::translate(glm::vec3(5, 0, 0)));
+        requireClose(batch, fullBatch);
+        REQUIRE(glm::length(batch.bounds().min - fullBatch.bounds().min) < 0.005f);
+        REQUIRE(glm::length(batch.bounds().max - fullBatch.bounds().max) < 0.005f);
+    }
+
+    SECTION("and unpacked again")
+    {
+        compact.setVertexFormat(VertexFormat::Full);
+        REQUIRE(compact.origin() == glm::vec3(0, 0, 0));
+        REQUIRE(compact.vertices().size() == full.vertexCount());
+        requireClose(compact, full);
+    }
+}
+
+TEST_CASE("SIMD face normals match the scalar ones", "[Model]")
+{
+    // 103 triangles, so the last few don't fill a SIMD batch, with a flat one among them.
+    srand(11);
+    std::vector<Vertex> vertices(103 * 3);
+    std::vector<GLuint> indices(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        float x = rand() / (float)RAND_MAX, y = rand() / (float)RAND_MAX;
+        float z = rand() / (float)RAND_MAX;
+        vertices[i] = {glm::vec3(x, y, z) * 10.0f - glm::vec3(5.0f), 0, 0};
+        indices[i] = vertices.size() - 1 - i;
+    }
+    vertices[307].position = vertices[308].position;
+
+    std::vector<Vertex> scalar = vertices;
+    faceNormals(vertices.data(), indices.data(), indices.size() / 3);
+    faceNormalsScalar(scalar.data(), indices.data(), indices.size() / 3);
+    for (size_t i = 0; i < vertices.size(); i++) {
+        glm::vec4 simd = glm::unpackSnorm3x10_1x2(vertices[i].normal);
+        glm::vec4 plain = glm::unpackSnorm3x10_1x2(scalar[i].normal);
+        for (int axis = 0; axis < 3; axis++) {
+            REQUIRE(simd[axis] == Approx(plain[axis]).epsilon(0.003));
+        }
+        REQUIRE(glm::length(glm::vec3(simd)) == Approx(1.0f).epsilon(0.01));
+    }
+    glm::vec4 flat = glm::unpackSnorm3x10_1x2(vertices[306].normal);
+    REQUIRE(flat.y == 1.0f);
+}
+
+TEST_CASE("Deferred normals come out the same as ones worked out per shape", "[Model]")
+{
+    Model eager, deferred;
+    deferred.deferNormals();
+    for (Model *model : {&eager, &deferred}) {
+        for (int i = 0; i < 5; i++) {
+            glm::vec3 top(i, 2.0f + i, 0.5f * i);
+            model->AddTetra(Color(0.5f, 0.5f, 0.5f), top, glm::vec3(i, 0, 0),
+                            glm::vec3(i + 1, 0, 1), glm::vec3(i, 0, 2),
+                            (i % 2 == 0) ? Model::TetraFaces::All : Model::TetraFaces::Sides);
+            model->AddBoxFromCenter(Color(1, 0, 0), top, glm::vec3(1, 2, 3),
+                                    glm::angleAxis(0.3f * i, glm::vec3(0, 1, 0)));
+        }
+    }
+    // Nothing is worked out until it's asked for.
+    REQUIRE(deferred.vertices()[0].normal == 0);
+    deferred.fillNormals();
+    REQUIRE(deferred.vertexCount() == eager.vertexCount());
+    for (size_t i = 0; i < eager.vertexCount(); i++) {
+        REQUIRE(deferred.vertices()[i].normal == eager.vertices()[i].normal);
+    }
+}
+
+TEST_CASE("Models can be baked into other models", "[Model]")
+{
+    Model part;
+    part.AddBoxFromCorner(Color(1, 0, 0), glm::vec3(0, 0, 0), glm::vec3(1, 1, 1));
+
+    Model batch;
+    batch.Append(part, glm::translate(glm::vec3(10, 0, 0)));
+    batch.Append(part, glm::translate(glm::vec3(0, 0, 10)));
+
+    REQUIRE(batch.vertexCount() == 2 * part.vertexCount());
+    REQUIRE(batch.indexCount() == 2 * part.indexCount());
+    for (size_t i = 0; i < part.vertexCount(); i++) {
+        REQUIRE(batch.vertices()[i].position[0] == Approx(part.vertices()[i].position[0] + 10));
+        REQUIRE(batch.vertices()[i + 24].position[2] == Approx(part.vertices()[i].position[2] + 10));
+        REQUIRE(batch.vertices()[i].normal == part.vertices()[i].normal);
+    }
+    for (size_t i = 0; i < part.indexCount(); i++) {
+        REQUIRE(batch.indices()[i + 36] == part.indices()[i] + 24);
+    }
+}
+
+TEST_CASE("Optimized models draw the same triangles with fewer vertices", "[Model]")
+{
+    // Flush boxes of one color, so their coplanar faces share corners once welded.
+    Model grid;
+    for (int x = 0; x < 8; x++) {
+        for (int z = 0; z < 8; z++) {
+            grid.AddBoxFromCorner(Color(0.5f, 0.5f, 0.5f), glm::vec3(x, 0, z), glm::vec3(1, 1, 1));
+        }
+    }
+    // Each triangle by its corners in order, and sorted, since the order of triangles changes.
+    auto triangles = [](const Model &model) {
+        std::vector<std::array<double, 15>> all;
+        const std::vector<GLuint> &indices = model.indices();
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            std::array<double, 15> triangle;
+            for (int corner = 0; corner < 3; corner++) {
+                Vertex v = model.vertex(indices[i + corner]);
+                double values[] = {v.position.x, v.position.y, v.position.z, double(v.color),
+                                   double(v.normal)};
+                std::copy(values, values + 5, triangle.begin() + corner * 5);
+            }
+            all.push_back(triangle);
+        }
+        std::sort(all.begin(), all.end());
+        return all;
+    };
+    auto before = triangles(grid);
+    float missesBefore = averageCacheMissRatio(grid.indices().data(), grid.indexCount(),
+                                               grid.vertexCount());
+    size_t verticesBefore = grid.vertexCount();
+
+    grid.optimize();
+    REQUIRE(triangles(grid) == before);
+    // The tops and bottoms are 9 by 9 grids of corners. Sides facing each of the 4 ways are
+    // on 8 planes of 9 by 2 corners; touching sides face opposite ways, so aren't welded.
+    REQUIRE(grid.vertexCount() < verticesBefore);
+    REQUIRE(grid.vertexCount() == 81 * 2 + 4 * 8 * 9 * 2);
+    for (GLuint index : grid.indices()) {
+        REQUIRE(index < grid.vertexCount());
+    }
+    // A quad's own corners are already reused; shared corners only help with the welding.
+    REQUIRE(missesBefore == Approx(2.0f));
+    float missesAfter =
+        averageCacheMissRatio(grid.indices().data(), grid.indexCount(), grid.vertexCount());
+    REQUIRE(missesAfter < 1.5f);
+
+    // Each vertex is first used in order, so fetching them walks forward through memory.
+    GLuint next = 0;
+    for (GLuint index : grid.indices()) {
+        REQUIRE(index <= next);
+        next = std::max<GLuint>(next, index + 1);
+    }
+}
+
+TEST_CASE("Vertex cache clusters also start where starting cold costs little", "[Model]")
+{
+    Model grid;
+    for (int x = 0; x < 8; x++) {
+        for (int z = 0; z < 8; z++) {
+            grid.AddBoxFromCorner(Color(0.5f, 0.5f, 0.5f), glm::vec3(x, 0, z), glm::vec3(1, 1, 1));
+        }
+    }
+    std::vector<Vertex> vertices = grid.vertices();
+    std::vector<GLuint> indices = grid.indices();
+    weldVertices(vertices.data(), vertices.size(), indices.data(), indices.size());
+    const size_t triangleCount = indices.size() / 3;
+
+    // A threshold of 0 only starts clusters where the order starts again with a cold cache.
+    std::vector<GLuint> cold = indices, split = indices;
+    std::vector<size_t> coldStarts, clusters;
+    optimizeVertexCache(cold.data(), cold.size(), vertices.size(), 16, &coldStarts, 0.0f);
+    optimizeVertexCache(split.data(), split.size(), vertices.size(), 16, &clusters);
+    REQUIRE(split == cold);
+    REQUIRE(clusters.size() > coldStarts.size());
+    REQUIRE(clusters[0] == 0);
+    REQUIRE(std::is_sorted(clusters.begin(), clusters.end()));
+    REQUIRE(clusters.back() < triangleCount);
+    for (size_t start : coldStarts) {
+        REQUIRE(std::binary_search(clusters.begin(), clusters.end(), start));
+    }
+
+    // Drawing every cluster from a cold cache, as they will be in any order, costs only a
+    // little more than drawing them all in a row.
+    auto misses = [&](size_t first, size_t end) {
+        return averageCacheMissRatio(split.data() + first * 3, (end - first) * 3,
+                                     vertices.size()) *
+               (end - first);
+    };
+    float inClusters = 0;
+    for (size_t c = 0; c < clusters.size(); c++) {
+        inClusters += misses(clusters[c], (c + 1 < clusters.size()) ? clusters[c + 1]
+                                                                    : triangleCount);
+    }
+    float inRow = misses(0, triangleCount);
+    REQUIRE(inClusters > inRow);
+    REQUIRE(inClusters < 1.2f * inRow);
+
+    // Sorting the clusters moves them around, and keeps every triangle.
+    std::vector<GLuint> sorted = split;
+    optimizeOverdraw(vertices.data(), sorted.data(), sorted.size(), clusters);
+    REQUIRE(sorted != split);
+    std::vector<std::array<GLuint, 3>> before, after;
+    for (size_t t = 0; t < triangleCount; t++) {
+        before.push_back({{split[t * 3], split[t * 3 + 1], split[t * 3 + 2]}});
+        after.push_back({{sorted[t * 3], sorted[t * 3 + 1], sorted[t * 3 + 2]}});
+    }
+    std::sort(before.begin(), before.end());
+    std::sort(after.begin(), after.end());
+    REQUIRE(before == after);
+}
@@ -0,0 +1,750 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <limits>
+#include <map>
+#include <set>
+#include <thread>
+#include "AnimationTable.hpp"
+#include "ChunkLifetimes.hpp"
+#include "Frustum.hpp"
+#include "GenerationQueue.hpp"
+#include "ObjectStore.hpp"
+#include "Params/SceneParams.h"
+#include "Random.hpp"
+#include "SceneObjects/Model.hpp"
+#include "SceneObjects/RockObject.hpp"
+#include "SceneObjects/TreeObject.hpp"
+#include "SpatialGrid.hpp"
+#include "TaskPool.hpp"
+#include "catch.hpp"
+
+using namespace ParamWorld;
+
+TEST_CASE("Frustums cull boxes that the camera can't see", "[Frustum]")
+{
+    glm::mat4 perspective = glm::perspective(45.0f, 4.0f / 3.0f, 0.1f, 1000.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0, 1.7f, 0), glm::vec3(0, 1.7f, 1), glm::vec3(0, 1, 0));
+    Frustum frustum(perspective * view);
+
+    Bounds ahead, behind, beyondFar, straddling, empty;
+    ahead.extend(glm::vec3(-1, 0, 9));
+    ahead.extend(glm::vec3(1, 2, 11));
+    behind.extend(glm::vec3(-1, 0, -11));
+    behind.extend(glm::vec3(1, 2, -9));
+    beyondFar.extend(glm::vec3(-1, 0, 1100));
+    beyondFar.extend(glm::vec3(1, 2, 1102));
+    straddling.extend(glm::vec3(-100, 0, -5));
+    straddling.extend(glm::vec3(100, 2, 5));
+
+    REQUIRE(frustum.intersects(ahead));
+    REQUIRE_FALSE(frustum.intersects(behind));
+    REQUIRE_FALSE(frustum.intersects(beyondFar));
+    REQUIRE(frustum.intersects(straddling));
+    REQUIRE_FALSE(frustum.intersects(empty));
+
+    REQUIRE(frustum.intersects(ahead.center(), ahead.radius()));
+    REQUIRE_FALSE(frustum.intersects(behind.center(), behind.radius()));
+}
+
+TEST_CASE("Model bounds cover triangles and instances", "[Model]")
+{
+    Model m;
+    REQUIRE(m.bounds().empty());
+
+    m.AddBoxFromCorner(Color(1, 1, 1), glm::vec3(0, 0, 0), glm::vec3(1, 1, 1));
+    REQUIRE(m.bounds().min[0] == Approx(0));
+    REQUIRE(m.bounds().max[1] == Approx(1));
+
+    // Turned 90 degrees about z, a tall box becomes wide.
+    m.AddBoxInstance(Color(1, 1, 1), glm::vec3(0, 5, 0), glm::vec3(1, 4, 1),
+                     glm::angleAxis(3.1415926f / 2.0f, glm::vec3(0, 0, 1)));
+    REQUIRE(m.bounds().min[0] == Approx(-2).epsilon(0.001));
+    REQUIRE(m.bounds().max[0] == Approx(2).epsilon(0.001));
+    REQUIRE(m.bounds().max[1] == Approx(5.5).epsilon(0.001));
+}
+
+TEST_CASE("Spatial grids find items near a point", "[SpatialGrid]")
+{
+    SpatialGrid<int> grid;
+    grid.insert(glm::vec3(0.5f, 0, 0.5f), 1);
+    grid.insert(glm::vec3(-0.5f, 0, -0.5f), 2);  // In a different square than 1.
+    grid.insert(glm::vec3(4.9f, 0, 0), 3);
+    grid.insert(glm::vec3(100, 0, 100), 4);
+    REQUIRE(grid.size() == 4);
+
+    std::vector<int> found;
+    auto collect = [&](int item) { found.push_back(item); };
+
+    SECTION("only items within the radius are visited")
+    {
+        grid.forEachNear(glm::vec3(0, 0, 0), 2.0f, collect);
+        std::sort(found.begin(), found.end());
+        REQUIRE(found == std::vector<int>({1, 2}));
+    }
+
+    SECTION("queries reach into neighboring squares")
+    {
+        grid.forEachNear(glm::vec3(5.5f, 0, 0), 1.0f, collect);
+        REQUIRE(found == std::vector<int>({3}));
+    }
+
+    SECTION("removed items aren't found anymore")
+    {
+        REQUIRE(grid.remove(glm::vec3(0.5f, 0, 0.5f), 1));
+        REQUIRE_FALSE(grid.remove(glm::vec3(0.5f, 0, 0.5f), 1));
+        REQUIRE(grid.size() == 3);
+        grid.forEachNear(glm::vec3(0, 0, 0), 2.0f, collect);
+        REQUIRE(found == std::vector<int>({2}));
+    }
+
+    SECTION("squares below zero are the same size as the rest")
+    {
+        REQUIRE(Square::containing(glm::vec3(-0.1f, 0, 0.1f)) == Square(-1, 0));
+        REQUIRE(Square::containing(glm::vec3(4.9f, 0, -5.0f)) == Square(0, -1));
+    }
+
+    SECTION("squares around the origin all hash differently")
+    {
+        // The explored area grows around the origin, so mirrored squares and the diagonal
+        // must not share hashes.
+        std::set<size_t> hashes;
+        for (int x = -20; x <= 20; x++) {
+            for (int z = -20; z <= 20; z++) {
+                hashes.insert(std::hash<Square>()(Square(x, z)));
+            }
+        }
+        REQUIRE(hashes.size() == 41 * 41);
+    }
+}
+
+TEST_CASE("Object stores hand out handles that outlive other objects", "[ObjectStore]")
+{
+    ObjectStore store;
+    ObjectHandle a = store.add(std::unique_ptr<SceneObject>(new Ground(1.0f)));
+    ObjectHandle b = store.add(std::unique_ptr<SceneObject>(new Ground(2.0f)));
+    SceneObject *bObject = store.get(b);
+    REQUIRE(store.size() == 2);
+    REQUIRE(store.get(a) != nullptr);
+
+    REQUIRE(store.remove(a));
+    REQUIRE_FALSE(store.remove(a));
+    REQUIRE(store.get(a) == nullptr);
+    REQUIRE(store.get(b) == bObject);
+
+    // The freed slot gets reused, but the old handle still doesn't find anything.
+    ObjectHandle c = store.add(std::unique_ptr<SceneObject>(new Ground(3.0f)));
+    REQUIRE(c.index == a.index);
+    REQUIRE(store.get(a) == nullptr);
+    REQUIRE(store.get(c) != nullptr);
+    REQUIRE(store.size() == 2);
+}
+
+TEST_CASE("Generation queues build objects on worker threads", "[GenerationQueue]")
+{
+    GenerationQueue queue(2);
+    ParamArray<SP_Count> params(0.0f);
+    params[SP_Depth] = 3;
+    params[SP_Height] = 1;
+    params[SP_Width] = 0.2f;
+    params[SP_Scale] = 0.7f;
+    params[SP_Rock_Depth] = 2;
+    params[SP_Rock_HeightMult] = 1;
+
+    for (int i = 0; i < 8; i++) {
+        GenerationJob job;
+        job.kind = (i % 2 == 0) ? GenerationJob::Tree : GenerationJob::Rock;
+        job.rootPosition = glm::vec3(i, 0, 0);
+        job.params = params;
+        queue.push(job);
+    }
+
+    std::vector<GeneratedObject> done;
+    for (int tries = 0; tries < 500 && done.size() < 8; tries++) {
+        queue.collect(done);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE(done.size() == 8);
+    REQUIRE(queue.pending() == 0);
+    for (auto &finished : done) {
+        REQUIRE(finished.job.rootPosition == finished.object->rootPosition);
+        const Model &m = finished.object->getModel();
+        // Trees are 2^(depth + 1) - 1 box instances, rocks the sides of 9 tetras and a base.
+        bool tree = m.instanceCount() == 15 && m.vertexCount() == 0;
+        bool rock = m.instanceCount() == 0 && m.indexCount() == 28 * 3;
+        REQUIRE((tree || rock));
+    }
+
+    SECTION("workers only use their job's random numbers")
+    {
+        GenerationJob job;
+        job.kind = GenerationJob::Rock;
+        job.params = params;
+        job.seed = 5;
+        for (int i = 0; i < 8; i++) {
+            queue.push(job);
+        }
+        // Random numbers used on this thread meanwhile don't change the rocks.
+        Random mainThread(1);
+        for (int i = 0; i < 100000; i++) {
+            mainThread.next();
+        }
+        std::unique_ptr<SceneObject> expected = GenerationQueue::generate(job);
+        done.clear();
+        for (int tries = 0; tries < 500 && done.size() < 8; tries++) {
+            queue.collect(done);
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        REQUIRE(done.size() == 8);
+        const Model &m = expected->getModel();
+        for (auto &finished : done) {
+            const Model &built = finished.object->getModel();
+            REQUIRE(built.vertexCount() == m.vertexCount());
+            bool same = true;
+            for (size_t i = 0; i < m.vertexCount(); i++) {
+                same = same && built.vertex(i).position == m.vertex(i).position;
+            }
+            REQUIRE(same);
+        }
+    }
+}
+
+TEST_CASE("Far squares are evicted and come back from their jobs", "[ChunkLifetimes]")
+{
+    ChunkLifetimes lifetimes(100.0f, 0.8f);
+    GenerationJob near, far;
+    near.kind = GenerationJob::Tree;
+    near.rootPosition = glm::vec3(1, 0, 1);
+    near.params = ParamArray<SP_Count>(0.5f);
+    far = near;
+    far.kind = GenerationJob::Rock;
+    far.rootPosition = glm::vec3(-60, 0, 1);
+    lifetimes.addJob(near);
+    lifetimes.addJob(far);
+    REQUIRE(lifetimes.addObject(near, ObjectHandle{0, 0}));
+    REQUIRE(lifetimes.addObject(far, ObjectHandle{1, 0}));
+    REQUIRE(lifetimes.addObject(far, ObjectHandle{2, 0}));
+
+    std::vector<Square> squares;
+    std::vector<ObjectHandle> objects;
+    std::vector<GenerationJob> jobs;
+    lifetimes.update(glm::vec3(0, 0, 0), squares, objects, jobs);
+    REQUIRE(squares.empty());
+    REQUIRE(objects.empty());
+    REQUIRE(jobs.empty());
+
+    // Walking 120 to the left leaves the first square behind, but not the second.
+    lifetimes.update(glm::vec3(-120, 0, 0), squares, objects, jobs);
+    REQUIRE(squares.size() == 1);
+    REQUIRE(squares[0] == Square::containing(near.rootPosition));
+    REQUIRE(objects.size() == 1);
+    REQUIRE(objects[0] == (ObjectHandle{0, 0}));
+    REQUIRE(jobs.empty());
+    REQUIRE(lifetimes.residentSquares() == 1);
+    REQUIRE(lifetimes.evictedSquares() == 1);
+    // Objects that finish building after their square is gone aren't kept.
+    REQUIRE_FALSE(lifetimes.addObject(near, ObjectHandle{3, 0}));
+
+    // Coming back only part of the way isn't enough to build it again.
+    squares.clear();
+    objects.clear();
+    lifetimes.update(glm::vec3(-90, 0, 0), squares, objects, jobs);
+    REQUIRE(jobs.empty());
+
+    lifetimes.update(glm::vec3(-70, 0, 0), squares, objects, jobs);
+    REQUIRE(squares.empty());
+    REQUIRE(jobs.size() == 1);
+    REQUIRE(jobs[0].kind == GenerationJob::Tree);
+    REQUIRE(jobs[0].rootPosition == near.rootPosition);
+    REQUIRE(jobs[0].params[SP_Depth] == near.params[SP_Depth]);
+    // What comes back is built as it was when it left, not grown again.
+    REQUIRE(jobs[0].fullyGrown);
+    REQUIRE_FALSE(near.fullyGrown);
+    REQUIRE(GenerationQueue::generate(jobs[0])->isGrown());
+    REQUIRE(lifetimes.residentSquares() == 2);
+
+    // An object from the job queued before the eviction can still turn up now, but only the
+    // one from the job queued again is kept, so the square doesn't get both.
+    REQUIRE_FALSE(lifetimes.addObject(near, ObjectHandle{4, 0}));
+    REQUIRE(lifetimes.addObject(jobs[0], ObjectHandle{5, 0}));
+
+    // Jobs added to the square after it came back belong to its new generation.
+    GenerationJob later = near;
+    lifetimes.addJob(later);
+    REQUIRE(later.generation == jobs[0].generation);
+    REQUIRE(lifetimes.addObject(later, ObjectHandle{6, 0}));
+
+    // Leaving again evicts both of the square's new objects, and nothing stale.
+    squares.clear();
+    jobs.clear();
+    lifetimes.update(glm::vec3(-120, 0, 0), squares, objects, jobs);
+    REQUIRE(squares.size() == 1);
+    REQUIRE(objects.size() == 2);
+    REQUIRE(objects[0] == (ObjectHandle{5, 0}));
+    REQUIRE(objects[1] == (ObjectHandle{6, 0}));
+}
+
+TEST_CASE("Squares remember what has been learned from them", "[ChunkLifetimes]")
+{
+    ChunkLifetimes lifetimes(100.0f, 0.8f);
+    Square home = Square::containing(glm::vec3(1, 0, 1));
+    REQUIRE(lifetimes.explore(home));
+    REQUIRE_FALSE(lifetimes.explore(home));
+
+    GenerationJob first, second;
+    first.kind = GenerationJob::Tree;
+    first.rootPosition = glm::vec3(1, 0, 1);
+    first.params = ParamArray<SP_Count>(0.5f);
+    second = first;
+    second.rootPosition = glm::vec3(2, 0, 2);
+    lifetimes.addJob(first);
+    lifetimes.addJob(second);
+    // A job landing in a square next door doesn't count as having been there.
+    GenerationJob nextDoor = first;
+    nextDoor.rootPosition = glm::vec3(-1, 0, 1);
+    lifetimes.addJob(nextDoor);
+    REQUIRE(lifetimes.explore(Square::containing(nextDoor.rootPosition)));
+
+    REQUIRE(lifetimes.addObject(first, ObjectHandle{0, 0}));
+    REQUIRE(lifetimes.addObject(second, ObjectHandle{1, 0}));
+    lifetimes.learn(second.rootPosition, ObjectHandle{1, 0});
+    REQUIRE_FALSE(lifetimes.learned(first.rootPosition, ObjectHandle{0, 0}));
+    REQUIRE(lifetimes.learned(second.rootPosition, ObjectHandle{1, 0}));
+
+    // When the square comes back, only the job that was learned from says so.
+    std::vector<Square> squares;
+    std::vector<ObjectHandle> objects;
+    std::vector<GenerationJob> jobs;
+    lifetimes.update(glm::vec3(200, 0, 0), squares, objects, jobs);
+    lifetimes.update(glm::vec3(0, 0, 0), squares, objects, jobs);
+    REQUIRE(jobs.size() == 3);
+    for (const GenerationJob &job : jobs) {
+        bool learned = job.rootPosition == second.rootPosition;
+        REQUIRE(job.learned == learned);
+        if (learned) {
+            REQUIRE(lifetimes.addObject(job, ObjectHandle{2, 0}));
+            REQUIRE(lifetimes.learned(job.rootPosition, ObjectHandle{2, 0}));
+        }
+    }
+    // And the square still counts as explored.
+    REQUIRE_FALSE(lifetimes.explore(home));
+}
+
+TEST_CASE("Animation tables grow objects until they're done", "[AnimationTable]")
+{
+    ObjectHandle rock = {0, 0}, tree = {1, 0}, ground = {2, 0};
+    Function linear = Function::linear(10.0, 15.0), logistic = Function::logistic(16.0, 1.0);
+    AnimationTable table;
+    table.add(rock, linear, glm::vec3(1, 2, 3));
+    table.add(tree, logistic, glm::vec3(-4, 0, 5));
+    table.add(ground, Function::constant(), glm::vec3(0, 0, 0));
+
+    std::vector<ObjectHandle> finished;
+    table.update(12.5, finished);
+    REQUIRE(finished.size() == 1);
+    REQUIRE(finished[0] == ground);
+    REQUIRE(table.size() == 2);
+    for (size_t i = 0; i < table.size(); i++) {
+        // The same matrix the object would have worked out on its own.
+        bool isRock = table.handle(i) == rock;
+        double scale = (isRock ? linear : logistic).at(12.5);
+        glm::vec3 root = isRock ? glm::vec3(1, 2, 3) : glm::vec3(-4, 0, 5);
+        glm::mat4 expected = glm::translate(root) * glm::scale(glm::vec3(scale, scale, scale));
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                REQUIRE(table.modelMatrix(i)[column][row] ==
+                        Approx(expected[column][row]).epsilon(1e-6));
+            }
+        }
+    }
+
+    finished.clear();
+    table.update(15.0, finished);
+    REQUIRE(finished.size() == 1);
+    REQUIRE(finished[0] == rock);
+    REQUIRE(linear.saturated(15.0));
+    REQUIRE_FALSE(logistic.saturated(15.0));
+
+    finished.clear();
+    table.update(30.0, finished);
+    REQUIRE(finished.size() == 1);
+    REQUIRE(finished[0] == tree);
+    REQUIRE(logistic.at(30.0) >= 0.999);
+    REQUIRE(table.empty());
+
+    table.add(rock, linear, glm::vec3(1, 2, 3));
+    table.add(tree, logistic, glm::vec3(-4, 0, 5));
+    table.removeIf([&](ObjectHandle handle) { return handle == rock; });
+    REQUIRE(table.size() == 1);
+    REQUIRE(table.handle(0) == tree);
+}
+
+TEST_CASE("Random numbers come from the seed alone", "[Random]")
+{
+    Random a(42), b(42);
+    for (int i = 0; i < 100; i++) {
+        REQUIRE(a.next() == b.next());
+    }
+    // Children don't depend on how much their parent has been used.
+    REQUIRE(a.child(5).next() == Random(42).child(5).next());
+    REQUIRE(a.child(5).next() != a.child(6).next());
+    REQUIRE(Random(42).child(1).child(2).next() != Random(42).child(2).child(1).next());
+
+    Random random(7);
+    double sum = 0;
+    float low = 1.0f, high = 0.0f;
+    int counts[3] = {};
+    for (int i = 0; i < 30000; i++) {
+        float u = random.uniform();
+        low = std::min(low, u);
+        high = std::max(high, u);
+        sum += u;
+        counts[random.below(3)]++;
+    }
+    REQUIRE(low >= 0.0f);
+    REQUIRE(high < 1.0f);
+    REQUIRE(sum / 30000 == Approx(0.5).epsilon(0.01));
+    for (int count : counts) {
+        REQUIRE(count == Approx(10000).epsilon(0.05));
+    }
+
+    SECTION("rocks with the same seed have the same shape")
+    {
+        auto rock = [](uint64_t seed) {
+            return RockObject(3, Color(0.5f, 0.5f, 0.5f), glm::vec3(0, 0, 0), glm::vec2(1, 0),
+                              glm::vec2(-0.5f, -0.5f), glm::vec2(-0.5f, 0.5f), 1.0f, seed);
+        };
+        RockObject first = rock(9), again = rock(9), other = rock(10);
+        const Model &m = first.getModel();
+        REQUIRE(m.vertexCount() == again.getModel().vertexCount());
+        bool sameAsAgain = true, sameAsOther = true;
+        for (size_t i = 0; i < m.vertexCount(); i++) {
+            glm::vec3 position = m.vertex(i).position;
+            sameAsAgain = sameAsAgain && position == again.getModel().vertex(i).position;
+            sameAsOther = sameAsOther && position == other.getModel().vertex(i).position;
+        }
+        REQUIRE(sameAsAgain);
+        REQUIRE_FALSE(sameAsOther);
+    }
+}
+
+TEST_CASE("Task pools run nested tasks to completion", "[TaskPool]")
+{
+    TaskPool pool(3);
+    std::atomic<int> ran(0);
+    TaskPool::Group outer;
+    for (int i = 0; i < 16; i++) {
+        pool.submit(outer, [&] {
+            // Waiting inside a task runs other tasks instead of blocking a worker.
+            TaskPool::Group inner;
+            for (int j = 0; j < 16; j++) {
+                pool.submit(inner, [&] { ran++; });
+            }
+            pool.wait(inner);
+        });
+    }
+    pool.wait(outer);
+    REQUIRE(ran == 16 * 16);
+
+    SECTION("threads waiting on a running task sleep instead of spinning")
+    {
+        TaskPool::Group slow;
+        pool.submit(slow, [] { std::this_thread::sleep_for(std::chrono::milliseconds(300)); });
+        // Let a worker take it, so the wait has nothing to run itself.
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        std::clock_t start = std::clock();
+        pool.wait(slow);
+        double cpuSeconds = double(std::clock() - start) / CLOCKS_PER_SEC;
+        REQUIRE(cpuSeconds < 0.1);
+    }
+}
+
+TEST_CASE("Trees built in parallel match trees built serially", "[TreeObject]")
+{
+    Color leaf(0.1f, 0.8f, 0.2f), trunk(0.4f, 0.3f, 0.1f);
+    TreeObject::setParallelLevels(0);
+    TreeObject serial(glm::vec3(1, 0, 2), 7, 1.0f, 0.2f, 0.75f, 0.6f, leaf, trunk, 0.3f);
+    TreeObject::setParallelLevels(4);
+    TreeObject parallel(glm::vec3(1, 0, 2), 7, 1.0f, 0.2f, 0.75f, 0.6f, leaf, trunk, 0.3f);
+    TreeObject::setParallelLevels(3);
+
+    const auto &a = serial.getModel().instances();
+    const auto &b = parallel.getModel().instances();
+    REQUIRE(a.size() == 255);
+    REQUIRE(b.size() == a.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        REQUIRE(a[i].center == b[i].center);
+        REQUIRE(a[i].size == b[i].size);
+        REQUIRE(a[i].rotation == b[i].rotation);
+        REQUIRE(a[i].color == b[i].color);
+    }
+    REQUIRE(serial.getModel().bounds().min == parallel.getModel().bounds().min);
+    REQUIRE(serial.getModel().bounds().max == parallel.getModel().bounds().max);
+}
+
+TEST_CASE("Both branches of a tree are the same shape, moved and turned", "[TreeObject]")
+{
+    Color leaf(0.1f, 0.8f, 0.2f), trunk(0.4f, 0.3f, 0.1f);
+    TreeObject tree(glm::vec3(0, 0, 0), 5, 1.0f, 0.2f, 0.75f, 0.6f, leaf, trunk, 0.3f);
+    const auto &boxes = tree.getModel().instances();
+    REQUIRE(boxes.size() == 63);
+
+    // Each branch's boxes, seen from its own first box, in pre-order (see initModels).
+    const size_t branchSize = 31;
+    const BoxInstance *left = &boxes[1], *right = &boxes[1 + branchSize];
+    auto turn = [](const BoxInstance &box) {
+        return glm::fquat(box.rotation[3], box.rotation[0], box.rotation[1], box.rotation[2]);
+    };
+    float worst = 0;
+    for (size_t i = 0; i < branchSize; i++) {
+        glm::vec3 fromLeft =
+            glm::rotate(glm::inverse(turn(left[0])), left[i].center - left[0].center);
+        glm::vec3 fromRight =
+            glm::rotate(glm::inverse(turn(right[0])), right[i].center - right[0].center);
+        worst = std::max(worst, glm::length(fromLeft - fromRight));
+        worst = std::max(worst, glm::length(left[i].size - right[i].size));
+        REQUIRE(left[i].color == right[i].color);
+    }
+    REQUIRE(worst < 1e-5f);
+}
+
+TEST_CASE("Trees with close enough params share a cached mesh", "[TreeObject][MeshCache]")
+{
+    ParamArray<SP_Count> params(0.5f);
+    params[SP_Depth] = 4.7f;
+    params[SP_Height] = 2.0f;
+    MeshCache cache;
+
+    TreeObject first(glm::vec3(0, 0, 0), params, &cache);
+    params[SP_Width] += 0.01f;
+    params[SP_LeafG] -= 0.01f;
+    TreeObject close(glm::vec3(3, 0, 0), params, &cache);
+    REQUIRE(&close.getModel() == &first.getModel());
+    REQUIRE(cache.hits() == 1);
+    REQUIRE(cache.misses() == 1);
+    // Built from the rounded params, so it doesn't matter which tree came first.
+    REQUIRE(first.getModel().instanceCount() == 31);
+
+    params[SP_Height] = 4.0f;
+    TreeObject taller(glm::vec3(6, 0, 0), params, &cache);
+    REQUIRE(&taller.getModel() != &first.getModel());
+    REQUIRE(taller.getModel().bounds().max.y > first.getModel().bounds().max.y);
+
+    TreeObject uncached(glm::vec3(0, 0, 0), params);
+    REQUIRE(&uncached.getModel() != &taller.getModel());
+
+    SECTION("the least recently used meshes are dropped past the capacity")
+    {
+        cache.setCapacity(1);
+        REQUIRE(cache.size() == 1);
+        TreeObject again(glm::vec3(0, 0, 0), params, &cache);
+        REQUIRE(&again.getModel() == &taller.getModel());
+        cache.freeRetired();
+        // Still drawn by the trees that use it.
+        REQUIRE(first.getModel().instanceCount() == 31);
+    }
+}
+
+TEST_CASE("Quantized tree shapes stay inside their params' ranges", "[TreeObject][MeshCache]")
+{
+    ParamArray<SP_Count> low, high;
+    for (int i = 0; i < SP_Count; i++) {
+        low[i] = SceneParams::definition(i).min;
+        high[i] = SceneParams::definition(i).max;
+    }
+    for (const ParamArray<SP_Count> &params : {low, high}) {
+        ParamArray<SP_Count> shape = TreeObject::quantizeShape(params);
+        for (int i = 0; i < SP_Count; i++) {
+            const SParam &range = SceneParams::definition(i);
+            INFO("param " << i << " quantized from " << params[i] << " to " << shape[i]);
+            REQUIRE(shape[i] >= range.min);
+            REQUIRE(shape[i] <= range.max);
+        }
+    }
+
+    // The shortest tree isn't flattened into one with no height.
+    MeshCache cache;
+    low[SP_Depth] = 2;
+    TreeObject shortest(glm::vec3(0, 0, 0), low, &cache);
+    REQUIRE(shortest.getModel().bounds().max.y > 0.2f);
+}
+
+TEST_CASE("Trees and rocks have cheaper levels of detail", "[TreeObject][RockObject]")
+{
+    auto contains = [](const Bounds &outer, const Bounds &inner) {
+        for (int i = 0; i < 3; i++) {
+            if (inner.min[i] < outer.min[i] - 0.001f || inner.max[i] > outer.max[i] + 0.001f) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    SECTION("trees drop 2 and 4 levels of branches, then are a trunk and one blob")
+    {
+        Color leaf(0.1f, 0.8f, 0.2f), trunk(0.4f, 0.3f, 0.1f);
+        TreeObject tree(glm::vec3(0, 0, 0), 8, 1.0f, 0.2f, 0.75f, 0.6f, leaf, trunk, 0.3f);
+        REQUIRE(tree.lodCount() == 4);
+        REQUIRE(tree.getModel(0).instanceCount() == 511);
+        // 63 branches above the cut, with a blob on each of their 64 ends.
+        REQUIRE(tree.getModel(1).instanceCount() == 127);
+        REQUIRE(tree.getModel(2).instanceCount() == 31);
+        REQUIRE(tree.getModel(3).instanceCount() == 2);
+        REQUIRE(&tree.getModel(7) == &tree.getModel(3));
+        for (int lod = 1; lod < tree.lodCount(); lod++) {
+            REQUIRE(contains(tree.getModel(0).bounds(), tree.getModel(lod).bounds()));
+            REQUIRE(contains(tree.getModel(lod).bounds(), tree.getModel(0).bounds()));
+        }
+
+        TreeObject small(glm::vec3(0, 0, 0), 2, 1.0f, 0.2f, 0.75f, 0.6f, leaf, trunk, 0.3f);
+        REQUIRE(small.lodCount() == 2);
+    }
+
+    SECTION("rocks stop one and two levels earlier")
+    {
+        RockObject rock(3, Color(0.5f, 0.5f, 0.5f), glm::vec3(0, 0, 0), glm::vec2(1, 0),
+                        glm::vec2(-0.5f, -0.5f), glm::vec2(-0.5f, 0.5f), 1.0f);
+        REQUIRE(rock.lodCount() == 3);
+        // The sides of the last 27, 9 and 3 tetras, and the base of the first.
+        REQUIRE(rock.getModel(0).indexCount() == 82 * 3);
+        REQUIRE(rock.getModel(1).indexCount() == 28 * 3);
+        REQUIRE(rock.getModel(2).indexCount() == 10 * 3);
+        // Every level has the same base, whose corners are all the coarsest has on the ground.
+        auto base = [](const Model &model) {
+            std::set<std::array<float, 3>> corners;
+            for (size_t i = 0; i < model.vertexCount(); i++) {
+                glm::vec3 p = model.vertex(i).position;
+                if (p.y == 0.0f) {
+                    corners.insert({{p.x, p.y, p.z}});
+                }
+            }
+            return corners;
+        };
+        std::set<std::array<float, 3>> coarsest = base(rock.getModel(2)),
+                                       finest = base(rock.getModel(0));
+        REQUIRE(coarsest.size() == 3);
+        REQUIRE(std::includes(finest.begin(), finest.end(), coarsest.begin(), coarsest.end()));
+        for (int lod = 1; lod < rock.lodCount(); lod++) {
+            REQUIRE(contains(rock.getModel(0).bounds(), rock.getModel(lod).bounds()));
+        }
+    }
+}
+
+TEST_CASE("Rocks only keep the faces on their surface", "[RockObject]")
+{
+    auto rock = [](bool keepHiddenFaces) {
+        RockObject::setKeepHiddenFaces(keepHiddenFaces);
+        RockObject built(5, Color(0.5f, 0.5f, 0.5f), glm::vec3(0, 0, 0), glm::vec2(1, 0),
+                         glm::vec2(-0.5f, -0.5f), glm::vec2(-0.5f, 0.5f), 1.0f, 3);
+        RockObject::setKeepHiddenFaces(false);
+        return built;
+    };
+    // The volume inside a model's triangles, by the divergence theorem. Faces that are
+    // inside two tetras cancel out, so this is the volume of all the tetras either way.
+    auto volume = [](const Model &model) {
+        double sum = 0;
+        const std::vector<GLuint> &indices = model.indices();
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            glm::vec3 a = model.vertex(indices[i]).position;
+            glm::vec3 b = model.vertex(indices[i + 1]).position;
+            glm::vec3 c = model.vertex(indices[i + 2]).position;
+            sum += glm::dot(a, glm::cross(b, c)) / 6.0;
+        }
+        return sum;
+    };
+    RockObject all = rock(true), surface = rock(false);
+    const Model &full = all.getModel(), &outside = surface.getModel();
+    // Tops that would be below the ground are pushed up onto it. Some are, besides the three
+    // corners of the base, and everything below holds for the tetras on them too.
+    std::set<std::array<float, 3>> onGround;
+    for (size_t i = 0; i < outside.vertexCount(); i++) {
+        glm::vec3 p = outside.vertex(i).position;
+        if (p.y == 0.0f) {
+            onGround.insert({{p.x, p.y, p.z}});
+        }
+    }
+    REQUIRE(onGround.size() > 3 + 10);
+    REQUIRE(full.indexCount() == 364 * 12);
+    REQUIRE(outside.indexCount() == (3 * 243 + 1) * 3);
+    REQUIRE(outside.bounds().min == full.bounds().min);
+    REQUIRE(outside.bounds().max == full.bounds().max);
+    REQUIRE(volume(full) > 0.1);
+    REQUIRE(volume(outside) == Approx(volume(full)).epsilon(1e-3));
+
+    // Looking along each axis, the rock covers the same cells of a grid either way, and the
+    // nearest and furthest triangle in each is the same: the faces that were dropped were all
+    // hidden, and every face that can be seen is still there.
+    const int cells = 24;
+    Bounds box = full.bounds();
+    auto view = [&](const Model &model, int axis) {
+        int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        const float none = std::numeric_limits<float>::infinity();
+        std::vector<float> nearest(cells * cells, none), furthest(cells * cells, -none);
+        const std::vector<GLuint> &indices = model.indices();
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            glm::vec3 p[3];
+            for (int k = 0; k < 3; k++) {
+                p[k] = model.vertex(indices[i + k]).position;
+            }
+            float area = (p[1][u] - p[0][u]) * (p[2][v] - p[0][v]) -
+                         (p[2][u] - p[0][u]) * (p[1][v] - p[0][v]);
+            if (area == 0.0f) {
+                continue;  // edge on from this side.
+            }
+            for (int cell = 0; cell < cells * cells; cell++) {
+                float cu = box.min[u] + (cell % cells + 0.5f) * (box.max[u] - box.min[u]) / cells;
+                float cv = box.min[v] + (cell / cells + 0.5f) * (box.max[v] - box.min[v]) / cells;
+                // Barycentric coordinates of the cell's middle, projected onto the triangle.
+                float w[3];
+                for (int k = 0; k < 3; k++) {
+                    const glm::vec3 &a = p[(k + 1) % 3], &b = p[(k + 2) % 3];
+                    w[k] = ((b[u] - a[u]) * (cv - a[v]) - (cu - a[u]) * (b[v] - a[v])) / area;
+                }
+                if (w[0] < 0 || w[1] < 0 || w[2] < 0) {
+                    continue;
+                }
+                float depth = w[0] * p[0][axis] + w[1] * p[1][axis] + w[2] * p[2][axis];
+                nearest[cell] = std::min(nearest[cell], depth);
+                furthest[cell] = std::max(furthest[cell], depth);
+            }
+        }
+        nearest.insert(nearest.end(), furthest.begin(), furthest.end());
+        return nearest;
+    };
+    for (int axis = 0; axis < 3; axis++) {
+        std::vector<float> allFaces = view(full, axis), surfaceOnly = view(outside, axis);
+        int covered = 0, different = 0;
+        for (size_t i = 0; i < allFaces.size(); i++) {
+            covered += std::isfinite(allFaces[i]);
+            bool same = (allFaces[i] == surfaceOnly[i]) ||
+                        std::abs(allFaces[i] - surfaceOnly[i]) < 1e-4f;
+            different += !same;
+        }
+        // The rock fills a good part of its bounds from every side.
+        REQUIRE(covered > cells * cells / 2);
+        REQUIRE(different == 0);
+    }
+
+    // Nothing is missing: the surface is closed, with every edge of one triangle going back
+    // the other way along another.
+    std::map<std::array<float, 6>, int> edges;
+    const std::vector<GLuint> &indices = outside.indices();
+    for (size_t i = 0; i < indices.size(); i++) {
+        size_t next = (i % 3 == 2) ? i - 2 : i + 1;
+        glm::vec3 from = outside.vertex(indices[i]).position;
+        glm::vec3 to = outside.vertex(indices[next]).position;
+        edges[{{from.x, from.y, from.z, to.x, to.y, to.z}}]++;
+    }
+    int unmatched = 0;
+    for (const auto &edge : edges) {
+        const std::array<float, 6> &e = edge.first;
+        auto back = edges.find({{e[3], e[4], e[5], e[0], e[1], e[2]}});
+        if (back == edges.end() || back->second != edge.second) {
+            unmatched++;
+        }
+    }
+    REQUIRE(unmatched == 0);
+}
@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <iostream>
+#include <vector>
 #include "Params/AvailableParameters.h"
 #include "Params/ParamArray.hpp"
 #include "Params/SceneParams.h"
+#include "Params/TruncatedNormal.hpp"
 #include "catch.hpp"
 
 using namespace ParamWorld;
@@ -125,3 +128,73 @@ TEST_CASE("Vectors (float arrays) serve as params of SceneParam functions", "[Sc
         REQUIRE(sp.learningRate == Approx(0.75f * .999 * .999));
     }
 }
+
+TEST_CASE("Scene params from the same seed generate the same params", "[SceneParams]")
+{
+    SceneParams a(7), b(7), c(8);
+    bool allSame = true;
+    for (int i = 0; i < SP_Count; i++) {
+        REQUIRE(a.paramMeans[i] == b.paramMeans[i]);
+        allSame = allSame && a.paramMeans[i] == c.paramMeans[i];
+    }
+    REQUIRE_FALSE(allSame);
+
+    Random first(3), second(3);
+    ParamArray<SP_Count> x = a.generate(2.0f, first);
+    ParamArray<SP_Count> y = b.generate(2.0f, second);
+    for (int i = 0; i < SP_Count; i++) {
+        REQUIRE(x[i] == y[i]);
+        REQUIRE(x[i] >= a.AllParams[i]->min);
+        REQUIRE(x[i] <= a.AllParams[i]->max);
+    }
+}
+
+TEST_CASE("Truncated normals are sampled without rejection", "[SceneParams]")
+{
+    SECTION("the inverse CDF undoes the CDF, even far into the tails")
+    {
+        for (double p : {1e-300, 1e-10, 0.01, 0.3, 0.5, 0.9, 1.0 - 1e-10}) {
+            REQUIRE(normalCdf(inverseNormalCdf(p)) == Approx(p).epsilon(1e-6));
+        }
+    }
+
+    SECTION("values have the truncated distribution's mean")
+    {
+        // Standard normal cut to [-1, 2]: (pdf(-1) - pdf(2)) / (cdf(2) - cdf(-1)).
+        const int count = 20000;
+        std::vector<float> out(count);
+        Random random(5);
+        for (float &value : out) {
+            value = sampleTruncatedNormal(0.0f, 1.0f, -1.0f, 2.0f, random);
+        }
+        double sum = 0;
+        for (float value : out) {
+            sum += value;
+        }
+        REQUIRE(*std::min_element(out.begin(), out.end()) >= -1.0f);
+        REQUIRE(*std::max_element(out.begin(), out.end()) <= 2.0f);
+        REQUIRE(sum / count == Approx(0.2296).epsilon(0.04));
+    }
+
+    SECTION("means at or past a bound use one random number per value")
+    {
+        float mean[] = {1.0f, 10.0f, -50.0f, 0.5f};
+        float sigma[] = {0.5f, 0.01f, 0.01f, 0.0f};
+        float low[] = {0.0f, 0.0f, 0.0f, 0.0f}, high[] = {1.0f, 1.0f, 1.0f, 1.0f};
+        float out[4];
+        Random random(9), same(9);
+        for (int i = 0; i < 4; i++) {
+            out[i] = sampleTruncatedNormal(mean[i], sigma[i], low[i], high[i], random);
+        }
+        for (int i = 0; i < 4; i++) {
+            same.uniform();
+        }
+        REQUIRE(random.next() == same.next());
+        REQUIRE(out[0] >= 0.0f);
+        REQUIRE(out[0] <= 1.0f);
+        REQUIRE(out[1] == Approx(1.0f).epsilon(0.01));
+        REQUIRE(out[2] >= 0.0f);
+        REQUIRE(out[2] < 0.01f);
+        REQUIRE(out[3] == 0.5f);
+    }
+}